@@ -0,0 +1,708 @@
+/******************************************************************************/
+/*                                                                            */
+/* Copyright 2016-2017 Steven Dolly                                           */
+/*                                                                            */
+/* Licensed under the Apache License, Version 2.0 (the "License");            */
+/* you may not use this file except in compliance with the License.           */
+/* You may obtain a copy of the License at:                                   */
+/*                                                                            */
+/*     http://www.apache.org/licenses/LICENSE-2.0                             */
+/*                                                                            */
+/* Unless required by applicable law or agreed to in writing, software        */
+/* distributed under the License is distributed on an "AS IS" BASIS,          */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   */
+/* See the License for the specific language governing permissions and        */
+/* limitations under the License.                                             */
+/*                                                                            */
+/******************************************************************************/
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// SolutioBench.cpp                                                           //
+// Solutio Library Microbenchmarks                                            //
+// Created October 15, 2026                                                   //
+//                                                                            //
+// This program times the hot paths of the library (interpolation, NIST       //
+// attenuation lookups, TASMIP spectra, ray intersections, ray attenuation,   //
+// CT projections, fan-beam reconstruction and corrections-based dose) with   //
+// Google Benchmark. Results can be saved as JSON to track regressions        //
+// between releases:                                                          //
+//                                                                            //
+//   solutio_bench --benchmark_out=results.json --benchmark_out_format=json   //
+//                                                                            //
+// Configure with CMAKE_BUILD_TYPE=Release for meaningful timings. The data   //
+// folder defaults to the build copy of Data, and can be changed with the     //
+// SOLUTIO_DATA_DIR environment variable.                                     //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// C++ headers
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Google Benchmark
+#include <benchmark/benchmark.h>
+
+// Solutio library headers
+#include "Geometry/Cylinder.hpp"
+#include "Geometry/RayBatch.hpp"
+#include "Imaging/FanBeamFBP.hpp"
+#include "Imaging/FanBeamSART.hpp"
+#include "Imaging/ObjectModelXray.hpp"
+#include "Imaging/RayCT.hpp"
+#include "Imaging/Tasmip.hpp"
+#include "Imaging/VoxelModelXray.hpp"
+#include "Physics/NistPad.hpp"
+#include "Therapy/CBDose.hpp"
+#include "Therapy/MUCheck.hpp"
+#include "Therapy/RadiologicalDepth.hpp"
+#include "Utilities/DataInterpolation.hpp"
+
+namespace
+{
+  std::string DataFolder()
+  {
+    const char *folder = std::getenv("SOLUTIO_DATA_DIR");
+    return (folder != 0) ? std::string(folder) : std::string(SOLUTIO_DATA_DIR);
+  }
+  
+  std::string NistFolder(){ return DataFolder() + "/NISTX"; }
+  
+  // Keeps the library's progress messages out of the benchmark output while
+  // test data is loaded
+  class QuietOutput
+  {
+    public:
+      QuietOutput(){ saved = std::cout.rdbuf(sink.rdbuf()); }
+      ~QuietOutput(){ std::cout.rdbuf(saved); }
+    private:
+      std::ostringstream sink;
+      std::streambuf *saved;
+  };
+  
+  // Random values in [low, high), the same for every run
+  std::vector<double> RandomValues(int n, double low, double high)
+  {
+    std::mt19937 generator(12345);
+    std::uniform_real_distribution<double> uniform(low, high);
+    std::vector<double> values(n);
+    for(int i = 0; i < n; i++) values[i] = uniform(generator);
+    return values;
+  }
+  
+  // Water phantom with two bone inserts in a world of air, with the 120 kVp
+  // spectrum tabulated
+  struct XrayPhantom
+  {
+    XrayPhantom() : world(solutio::Vec3<double>(0, 0, 0), 60.0, 100.0),
+        body(solutio::Vec3<double>(0, 0, 0), 15.0, 30.0),
+        bone_1(solutio::Vec3<double>(5, 0, 0), 2.0, 30.0),
+        bone_2(solutio::Vec3<double>(-5, 3, 0), 1.5, 30.0)
+    {
+      QuietOutput quiet;
+      std::string folder = NistFolder();
+      model.AddMaterial(folder, "Air, Dry (near sea level)");
+      model.AddMaterial(folder, "Water, Liquid");
+      model.AddMaterial(folder, "Bone, Cortical (ICRU-44)");
+      model.AddObject("World", world, "None", "Air, Dry (near sea level)");
+      model.AddObject("Body", body, "World", "Water, Liquid");
+      model.AddObject("Bone 1", bone_1, "Body", "Bone, Cortical (ICRU-44)");
+      model.AddObject("Bone 2", bone_2, "Body", "Bone, Cortical (ICRU-44)");
+      model.MakeTree();
+      for(int e = 0; e < 151; e++) energies.push_back(double(e)/1000.0);
+      spectrum = solutio::Tasmip(120, 0.0, "Aluminum", folder);
+      model.TabulateAttenuationLists(energies, spectrum);
+    }
+    solutio::Cylinder world, body, bone_1, bone_2;
+    solutio::ObjectModelXray model;
+    std::vector<double> energies;
+    std::vector<double> spectrum;
+  };
+  
+  // Fan of rays crossing the phantom from a source 54 cm from the center
+  std::vector<solutio::Ray3> FanRays(int n)
+  {
+    std::vector<double> a = RandomValues(n, 0.0, 2.0*M_PI);
+    std::vector<double> b = RandomValues(n, -0.25, 0.25);
+    std::vector<solutio::Ray3> rays(n);
+    for(int i = 0; i < n; i++)
+    {
+      solutio::Vec3<double> source(54.0*cos(a[i]), 54.0*sin(a[i]), 0.0);
+      solutio::Vec3<double> direction(-108.0*cos(a[i] + b[i]),
+          -108.0*sin(a[i] + b[i]), 0.0);
+      rays[i].SetRay(source, direction);
+    }
+    return rays;
+  }
+}
+
+////////////////////////////
+// Interpolation routines //
+////////////////////////////
+
+static void BM_LinearInterpolation(benchmark::State &state)
+{
+  int n = state.range(0);
+  std::vector<double> x(n), y(n);
+  for(int i = 0; i < n; i++){ x[i] = i; y[i] = sqrt(double(i)); }
+  std::vector<double> queries = RandomValues(1024, 0.0, n - 1);
+  for(auto _ : state)
+  {
+    for(int q = 0; q < queries.size(); q++)
+    {
+      benchmark::DoNotOptimize(solutio::LinearInterpolation(x, y,
+          queries[q]));
+    }
+  }
+  state.SetItemsProcessed(state.iterations()*queries.size());
+}
+BENCHMARK(BM_LinearInterpolation)->Arg(32)->Arg(128)->Arg(1024);
+
+static void BM_LinearInterpolationSearch(benchmark::State &state)
+{
+  int n = state.range(0);
+  std::vector<double> x(n), y(n);
+  for(int i = 0; i < n; i++){ x[i] = i; y[i] = sqrt(double(i)); }
+  std::vector<double> queries = RandomValues(1024, 0.0, n - 1);
+  solutio::DataView<double> x_view(x), y_view(y);
+  for(auto _ : state)
+  {
+    for(int q = 0; q < queries.size(); q++)
+    {
+      benchmark::DoNotOptimize(solutio::LinearInterpolationSearch(x_view,
+          y_view, queries[q]));
+    }
+  }
+  state.SetItemsProcessed(state.iterations()*queries.size());
+}
+BENCHMARK(BM_LinearInterpolationSearch)->Arg(32)->Arg(128)->Arg(1024);
+
+static void BM_LogInterpolation(benchmark::State &state)
+{
+  int n = state.range(0);
+  std::vector<double> x(n), y(n);
+  for(int i = 0; i < n; i++)
+  {
+    x[i] = 1.0e-3*pow(1.0e4, double(i)/(n - 1));
+    y[i] = 1.0/x[i];
+  }
+  std::vector<double> queries = RandomValues(1024, 1.0e-3, 10.0);
+  for(auto _ : state)
+  {
+    for(int q = 0; q < queries.size(); q++)
+    {
+      benchmark::DoNotOptimize(solutio::LogInterpolation(x, y, queries[q]));
+    }
+  }
+  state.SetItemsProcessed(state.iterations()*queries.size());
+}
+BENCHMARK(BM_LogInterpolation)->Arg(32)->Arg(128);
+
+static void BM_LogInterpolationSearch(benchmark::State &state)
+{
+  int n = state.range(0);
+  std::vector<double> x(n), y(n);
+  for(int i = 0; i < n; i++)
+  {
+    x[i] = 1.0e-3*pow(1.0e4, double(i)/(n - 1));
+    y[i] = 1.0/x[i];
+  }
+  std::vector<double> log_x = solutio::Log10Table(solutio::MakeDataView(x));
+  std::vector<double> queries = RandomValues(1024, 1.0e-3, 10.0);
+  solutio::DataView<double> x_view(x), log_x_view(log_x), y_view(y);
+  for(auto _ : state)
+  {
+    for(int q = 0; q < queries.size(); q++)
+    {
+      benchmark::DoNotOptimize(solutio::LogInterpolationSearch(x_view,
+          log_x_view, y_view, queries[q]));
+    }
+  }
+  state.SetItemsProcessed(state.iterations()*queries.size());
+}
+BENCHMARK(BM_LogInterpolationSearch)->Arg(32)->Arg(128);
+
+//////////////////////
+// NIST attenuation //
+//////////////////////
+
+static void BM_NistPadLinearAttenuation(benchmark::State &state)
+{
+  QuietOutput quiet;
+  solutio::NistPad water(NistFolder(), "Water, Liquid");
+  std::vector<double> energies = RandomValues(1024, 0.001, 0.150);
+  for(auto _ : state)
+  {
+    for(int e = 0; e < energies.size(); e++)
+    {
+      benchmark::DoNotOptimize(water.LinearAttenuation(energies[e]));
+    }
+  }
+  state.SetItemsProcessed(state.iterations()*energies.size());
+}
+BENCHMARK(BM_NistPadLinearAttenuation);
+
+static void BM_NistPadLinearAttenuationGrid(benchmark::State &state)
+{
+  QuietOutput quiet;
+  solutio::NistPad water(NistFolder(), "Water, Liquid");
+  water.TabulateEnergyGrid(0.0, 0.150, 151);
+  std::vector<double> energies = RandomValues(1024, 0.001, 0.150);
+  for(auto _ : state)
+  {
+    for(int e = 0; e < energies.size(); e++)
+    {
+      benchmark::DoNotOptimize(water.LinearAttenuationGrid(energies[e]));
+    }
+  }
+  state.SetItemsProcessed(state.iterations()*energies.size());
+}
+BENCHMARK(BM_NistPadLinearAttenuationGrid);
+
+///////////////////////
+// TASMIP spectrum   //
+///////////////////////
+
+static void BM_Tasmip(benchmark::State &state)
+{
+  std::string folder = NistFolder();
+  QuietOutput quiet;
+  for(auto _ : state)
+  {
+    benchmark::DoNotOptimize(solutio::Tasmip(120, 3.0, "Aluminum", folder));
+  }
+}
+BENCHMARK(BM_Tasmip);
+
+//////////////////////////////
+// Ray geometry/attenuation //
+//////////////////////////////
+
+static void BM_CylinderRayPathlength(benchmark::State &state)
+{
+  solutio::Cylinder body(solutio::Vec3<double>(0, 0, 0), 15.0, 30.0);
+  solutio::GeometricObject &object = body;
+  std::vector<solutio::Ray3> rays = FanRays(4096);
+  for(auto _ : state)
+  {
+    for(int n = 0; n < rays.size(); n++)
+    {
+      benchmark::DoNotOptimize(object.RayPathlength(rays[n]));
+    }
+  }
+  state.SetItemsProcessed(state.iterations()*rays.size());
+}
+BENCHMARK(BM_CylinderRayPathlength);
+
+static void BM_CylinderRayPathlengths(benchmark::State &state)
+{
+  solutio::Cylinder body(solutio::Vec3<double>(0, 0, 0), 15.0, 30.0);
+  solutio::GeometricObject &object = body;
+  std::vector<solutio::Ray3> rays = FanRays(4096);
+  solutio::RayBatch batch(rays.size());
+  for(int n = 0; n < rays.size(); n++) batch.SetRay(n, rays[n]);
+  std::vector<double> pathlengths(rays.size());
+  for(auto _ : state)
+  {
+    object.RayPathlengths(batch, &pathlengths[0]);
+    benchmark::DoNotOptimize(pathlengths[0]);
+  }
+  state.SetItemsProcessed(state.iterations()*rays.size());
+}
+BENCHMARK(BM_CylinderRayPathlengths);
+
+// Arguments: 1 to use the transmission lookup tables, 1 to use single
+// precision spectrum sums
+static void BM_GetRayAttenuation(benchmark::State &state)
+{
+  XrayPhantom phantom;
+  if(state.range(0) != 0)
+  {
+    QuietOutput quiet;
+    phantom.model.TabulateTransmission(110.0, 1.0e-4);
+  }
+  phantom.model.SetSinglePrecision(state.range(1) != 0);
+  std::vector<solutio::Ray3> rays = FanRays(1024);
+  for(auto _ : state)
+  {
+    for(int n = 0; n < rays.size(); n++)
+    {
+      benchmark::DoNotOptimize(phantom.model.GetRayAttenuation(rays[n],
+          phantom.spectrum));
+    }
+  }
+  state.SetItemsProcessed(state.iterations()*rays.size());
+}
+BENCHMARK(BM_GetRayAttenuation)->Args({0, 0})->Args({1, 0})->Args({0, 1});
+
+// Ray attenuation with the spectrum compressed to a few energies
+static void BM_CompressedSpectrumAttenuation(benchmark::State &state)
+{
+  XrayPhantom phantom;
+  std::vector<double> compressed;
+  {
+    QuietOutput quiet;
+    phantom.model.CompressSpectrum(phantom.spectrum, 110.0, 1.0e-3,
+        compressed);
+  }
+  std::vector<solutio::Ray3> rays = FanRays(1024);
+  for(auto _ : state)
+  {
+    for(int n = 0; n < rays.size(); n++)
+    {
+      benchmark::DoNotOptimize(phantom.model.GetRayAttenuation(rays[n],
+          compressed));
+    }
+  }
+  state.SetItemsProcessed(state.iterations()*rays.size());
+}
+BENCHMARK(BM_CompressedSpectrumAttenuation);
+
+// Applying a new spectrum to rays traced once
+static void BM_ApplySpectrum(benchmark::State &state)
+{
+  XrayPhantom phantom;
+  std::vector<solutio::Ray3> rays = FanRays(1024);
+  solutio::RayBatch batch(rays.size());
+  for(int n = 0; n < rays.size(); n++) batch.SetRay(n, rays[n]);
+  solutio::RayPathCache cache;
+  phantom.model.TraceRays(batch, cache);
+  std::vector<double> attenuations(rays.size());
+  for(auto _ : state)
+  {
+    phantom.model.ApplySpectrum(cache, phantom.spectrum, &attenuations[0]);
+    benchmark::DoNotOptimize(attenuations.data());
+  }
+  state.SetItemsProcessed(state.iterations()*rays.size());
+}
+BENCHMARK(BM_ApplySpectrum);
+
+// The phantom above as a 512 x 512 x 4 label volume (0.0625 cm voxels)
+static void BM_VoxelRayAttenuation(benchmark::State &state)
+{
+  int n = 512;
+  double d = 32.0/n;
+  std::vector<unsigned char> labels(n*n*4, 0);
+  for(int k = 0; k < 4; k++)
+  {
+    for(int j = 0; j < n; j++)
+    {
+      for(int i = 0; i < n; i++)
+      {
+        double x = -16.0 + (i + 0.5)*d, y = -16.0 + (j + 0.5)*d;
+        unsigned char label = (x*x + y*y < 225.0) ? 1 : 0;
+        if((x - 5.0)*(x - 5.0) + y*y < 4.0) label = 2;
+        if((x + 5.0)*(x + 5.0) + (y - 3.0)*(y - 3.0) < 2.25) label = 2;
+        labels[((k*n + j)*n + i)] = label;
+      }
+    }
+  }
+  solutio::VoxelModelXray model;
+  std::vector<double> energies, spectrum;
+  {
+    QuietOutput quiet;
+    std::string folder = NistFolder();
+    model.AddMaterial(folder, "Air, Dry (near sea level)");
+    model.AddMaterial(folder, "Water, Liquid");
+    model.AddMaterial(folder, "Bone, Cortical (ICRU-44)");
+    model.SetVolume(n, n, 4, solutio::Vec3<double>(d, d, 0.5),
+        solutio::Vec3<double>(-16.0, -16.0, -1.0), labels);
+    model.AssignLabel(0, "Air, Dry (near sea level)");
+    model.AssignLabel(1, "Water, Liquid");
+    model.AssignLabel(2, "Bone, Cortical (ICRU-44)");
+    for(int e = 0; e < 151; e++) energies.push_back(double(e)/1000.0);
+    spectrum = solutio::Tasmip(120, 0.0, "Aluminum", folder);
+    model.TabulateAttenuationLists(energies, spectrum);
+  }
+  std::vector<solutio::Ray3> rays = FanRays(1024);
+  for(auto _ : state)
+  {
+    for(int n = 0; n < rays.size(); n++)
+    {
+      benchmark::DoNotOptimize(model.GetRayAttenuation(rays[n], spectrum));
+    }
+  }
+  state.SetItemsProcessed(state.iterations()*rays.size());
+}
+BENCHMARK(BM_VoxelRayAttenuation);
+
+// One full view of a clinical-size detector (888 channels x 16 rows)
+static void BM_ObjectProjection(benchmark::State &state)
+{
+  XrayPhantom phantom;
+  solutio::RayCT scanner;
+  {
+    QuietOutput quiet;
+    scanner.SetNistDataFolder(NistFolder());
+    scanner.SetGeometry(54.1, 888, 0.1, 16, 0.0625);
+    scanner.SetAcquisition(120, 1.0e6, 1);
+  }
+  double angle = 0.0;
+  for(auto _ : state)
+  {
+    benchmark::DoNotOptimize(scanner.ObjectProjection(phantom.model, angle,
+        0.0, phantom.spectrum));
+    angle += 0.01;
+  }
+  state.SetItemsProcessed(state.iterations()*888*16);
+}
+BENCHMARK(BM_ObjectProjection)->Unit(benchmark::kMillisecond);
+
+/////////////////////////////
+// Fan-beam reconstruction //
+/////////////////////////////
+
+// Clinical-size axial scan: 984 views of 888 channels into a 512 x 512 slice
+static void SetupReconstruction(solutio::FanBeamFBP &fbp,
+    std::vector<double> &line_integrals)
+{
+  fbp.SetGeometry(54.1, 888, 0.1, 1, 0.0625);
+  fbp.SetNumProjections(984);
+  fbp.SetImage(512, 0.1);
+  line_integrals = RandomValues(984*888, 0.0, 4.0);
+}
+
+static void BM_FanBeamFilter(benchmark::State &state)
+{
+  solutio::FanBeamFBP fbp;
+  std::vector<double> line_integrals;
+  SetupReconstruction(fbp, line_integrals);
+  std::vector<float> filtered;
+  for(auto _ : state)
+  {
+    fbp.FilterProjections(line_integrals, 0, filtered);
+    benchmark::DoNotOptimize(filtered.data());
+  }
+  state.SetItemsProcessed(state.iterations()*984);
+}
+BENCHMARK(BM_FanBeamFilter)->Unit(benchmark::kMillisecond);
+
+// Items are voxels of the reconstructed slice; the voxel_views counter gives
+// the rate of single-view pixel updates. Arg is the number of threads.
+static void BM_FanBeamBackprojection(benchmark::State &state)
+{
+  solutio::FanBeamFBP fbp;
+  std::vector<double> line_integrals;
+  SetupReconstruction(fbp, line_integrals);
+  fbp.SetNumThreads(state.range(0));
+  std::vector<float> filtered, image(512*512, 0.0f);
+  fbp.FilterProjections(line_integrals, 0, filtered);
+  for(auto _ : state)
+  {
+    fbp.Backproject(filtered, image.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations()*512*512);
+  state.counters["voxel_views"] = benchmark::Counter(
+      double(state.iterations())*512*512*984, benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_FanBeamBackprojection)->Arg(1)->Arg(0)
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// One OS-SART iteration over a 256 x 256 slice from 492 views; items are
+// rays. Arg is the number of subsets.
+static void BM_FanBeamSARTIteration(benchmark::State &state)
+{
+  solutio::FanBeamSART sart;
+  sart.SetGeometry(54.1, 888, 0.1, 1, 0.0625);
+  sart.SetNumProjections(492);
+  sart.SetImage(256, 0.2);
+  sart.SetNumSubsets(state.range(0));
+  std::vector<double> line_integrals = RandomValues(492*888, 0.0, 4.0);
+  std::vector<float> image(256*256, 0.0f);
+  for(auto _ : state)
+  {
+    sart.ReconstructSlice(line_integrals, 0, 1, image.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations()*492*888);
+}
+BENCHMARK(BM_FanBeamSARTIteration)->Arg(1)->Arg(12)->Arg(41)
+    ->Unit(benchmark::kMillisecond);
+
+//////////////////////////
+// Corrections-based MU //
+//////////////////////////
+
+static void BM_CBDoseCalcDose(benchmark::State &state)
+{
+  CBDose calc;
+  {
+    QuietOutput quiet;
+    calc.LoadData(DataFolder() + "/BeamData/tg-71-6mv.dat");
+  }
+  std::vector<double> sizes = RandomValues(256, 2.0, 15.0);
+  std::vector<double> depths = RandomValues(256, 1.0, 25.0);
+  std::vector<LinacBeam> beams(sizes.size());
+  std::vector<CalcPoint> points(sizes.size());
+  for(int n = 0; n < sizes.size(); n++)
+  {
+    beams[n].SetFieldSize(sizes[n], sizes[n]);
+    beams[n].SetSSD(100.0 - depths[n]);
+    points[n].SetPoint(depths[n], 0.0);
+  }
+  for(auto _ : state)
+  {
+    for(int n = 0; n < beams.size(); n++)
+    {
+      benchmark::DoNotOptimize(calc.CalcDose(100.0, beams[n], points[n]));
+    }
+  }
+  state.SetItemsProcessed(state.iterations()*beams.size());
+}
+BENCHMARK(BM_CBDoseCalcDose);
+
+// 100 depths x 10^4 off-axis points, all threads
+static void BM_CBDoseCalcDoseGrid(benchmark::State &state)
+{
+  CBDose calc;
+  {
+    QuietOutput quiet;
+    calc.LoadData(DataFolder() + "/BeamData/tg-71-6mv.dat");
+  }
+  LinacBeam beam;
+  beam.SetFieldSize(5.0, 7.5);
+  beam.SetSSD(90.0);
+  std::vector<float> depths, oads, doses;
+  for(int i = 0; i < 100; i++)
+  {
+    for(int j = 0; j < 10000; j++)
+    {
+      depths.push_back(1.5 + 23.0*i/99.0);
+      oads.push_back(14.0*(j % 100)/99.0);
+    }
+  }
+  for(auto _ : state)
+  {
+    calc.CalcDoseGrid(100.0, beam, depths, oads, doses);
+    benchmark::DoNotOptimize(doses.data());
+  }
+  state.SetItemsProcessed(state.iterations()*depths.size());
+}
+BENCHMARK(BM_CBDoseCalcDoseGrid)->Unit(benchmark::kMillisecond);
+
+static void BM_CBDoseLoadData(benchmark::State &state)
+{
+  for(auto _ : state)
+  {
+    CBDose calc;
+    benchmark::DoNotOptimize(calc.LoadData(DataFolder() +
+        "/BeamData/tg-71-6mv.dat"));
+  }
+}
+BENCHMARK(BM_CBDoseLoadData)->Unit(benchmark::kMicrosecond);
+
+// Binary model with uniform tables, written to the working directory
+static void BM_CBDoseLoadModel(benchmark::State &state)
+{
+  std::string model_file = "BM_CBDoseLoadModel.bin";
+  {
+    CBDose calc;
+    calc.SetUniformResolution(0.5, 0.5, 0.5);
+    calc.LoadData(DataFolder() + "/BeamData/tg-71-6mv.dat");
+    calc.SaveModel(model_file);
+  }
+  for(auto _ : state)
+  {
+    CBDose calc;
+    benchmark::DoNotOptimize(calc.LoadModel(model_file));
+  }
+  std::remove(model_file.c_str());
+}
+BENCHMARK(BM_CBDoseLoadModel)->Unit(benchmark::kMicrosecond);
+
+// 10^4 plans of 10 fields, with two shared beam models; arg = threads
+static void BM_MUCheckEngine(benchmark::State &state)
+{
+  MUCheckEngine engine;
+  for(int m = 0; m < 2; m++)
+  {
+    std::shared_ptr<CBDose> model(new CBDose);
+    model->SetUniformResolution(0.5*m, 0.5*m, 0.5*m);
+    model->LoadData(DataFolder() + "/BeamData/tg-71-6mv.dat");
+    engine.AddBeamModel(model);
+  }
+  std::vector<double> sizes = RandomValues(100000, 2.0, 15.0);
+  std::vector<double> depths = RandomValues(100000, 1.0, 25.0);
+  std::vector<MUCheckRecord> records(sizes.size());
+  for(int n = 0; n < records.size(); n++)
+  {
+    records[n].plan = n/10;
+    records[n].field = n % 10;
+    records[n].model = (n/10) % 2;
+    records[n].beam.SetFieldSize(sizes[n], sizes[(records.size()-1-n)]);
+    records[n].beam.SetSSD(100.0 - depths[n]);
+    records[n].point.SetPoint(depths[n], 0.0);
+    records[n].dose = 200.0;
+  }
+  engine.SetNumThreads(state.range(0));
+  std::vector<MUCheckResult> results;
+  for(auto _ : state)
+  {
+    engine.Run(records, results);
+    benchmark::DoNotOptimize(results.data());
+  }
+  state.SetItemsProcessed(state.iterations()*records.size());
+}
+BENCHMARK(BM_MUCheckEngine)->Arg(1)->Arg(0)->Unit(benchmark::kMillisecond);
+
+// Water box with a lung slab (0.5 cm voxels); one trace of 61 x 61 ray
+// lines, then the radiological depths and corrected doses of 10^6 points
+static void BM_CBDoseHeterogeneity(benchmark::State &state)
+{
+  int n = 80, n_z = 60;
+  std::vector<unsigned char> labels(n*n*n_z, 1);
+  std::fill(labels.begin() + 10*n*n, labels.begin() + 20*n*n, 2);
+  solutio::VoxelModelXray model;
+  CBDose calc;
+  {
+    QuietOutput quiet;
+    std::string folder = NistFolder();
+    model.AddMaterial(folder, "Water, Liquid");
+    model.AddMaterial(folder, "Lung Tissue (ICRU-44)", "Lung", 0.26);
+    model.SetVolume(n, n, n_z, solutio::Vec3<double>(0.5, 0.5, 0.5),
+        solutio::Vec3<double>(-20.0, -20.0, 0.0), labels);
+    model.AssignLabel(1, "Water, Liquid");
+    model.AssignLabel(2, "Lung");
+    calc.LoadData(DataFolder() + "/BeamData/tg-71-6mv.dat");
+  }
+  LinacBeam beam;
+  beam.SetFieldSize(10.0, 10.0);
+  beam.SetSSD(100.0);
+  std::vector< solutio::Vec3<double> > points;
+  for(int k = 0; k < 100; k++)
+  {
+    for(int j = 0; j < 100; j++)
+    {
+      for(int i = 0; i < 100; i++)
+      {
+        points.push_back(solutio::Vec3<double>(-10.0 + 0.2*i,
+            -10.0 + 0.2*j, 0.5 + 0.25*k));
+      }
+    }
+  }
+  RadiologicalDepth ray_lines;
+  ray_lines.SetBeam(solutio::Vec3<double>(0.0, 0.0, -100.0),
+      solutio::Vec3<double>(0.0, 0.0, 1.0), 100.0);
+  ray_lines.SetRayGrid(0.5, 15.0, 95.0, 135.0, 0.25);
+  std::vector<float> depths, oads, radiological_depths, doses;
+  for(auto _ : state)
+  {
+    ray_lines.TraceModel(model);
+    ray_lines.CalcPoints(points, 100.0, depths, oads, radiological_depths);
+    calc.CalcDoseGrid(100.0, beam, depths, radiological_depths, oads, doses,
+        "SSD");
+    benchmark::DoNotOptimize(doses.data());
+  }
+  state.SetItemsProcessed(state.iterations()*points.size());
+}
+BENCHMARK(BM_CBDoseHeterogeneity)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,62 @@
+/******************************************************************************/
+/*                                                                            */
+/* Copyright 2016-2017 Steven Dolly                                           */
+/*                                                                            */
+/* Licensed under the Apache License, Version 2.0 (the "License");            */
+/* you may not use this file except in compliance with the License.           */
+/* You may obtain a copy of the License at:                                   */
+/*                                                                            */
+/*     http://www.apache.org/licenses/LICENSE-2.0                             */
+/*                                                                            */
+/* Unless required by applicable law or agreed to in writing, software        */
+/* distributed under the License is distributed on an "AS IS" BASIS,          */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   */
+/* See the License for the specific language governing permissions and        */
+/* limitations under the License.                                             */
+/*                                                                            */
+/******************************************************************************/
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// NistPack.cpp                                                               //
+// NISTX Database Packing Tool                                                //
+// Created October 15, 2026                                                   //
+//                                                                            //
+// This program packs a NISTX data folder (all elements and compounds) into   //
+// one binary file, which can then be mapped by the NistRegistry in place of  //
+// the text files:                                                            //
+//                                                                            //
+//   NistPack <NISTX folder> <packed file>                                    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// C++ headers
+#include <iostream>
+#include <string>
+
+// Solutio library headers
+#include "Physics/NistPack.hpp"
+
+int main(int argc, char *argv[])
+{
+  if(argc != 3)
+  {
+    std::cout << "Usage: NistPack <NISTX folder> <packed file>\n";
+    return 1;
+  }
+  std::string folder = argv[1];
+  std::string packed_file = argv[2];
+  
+  // Pack the data folder
+  if(!solutio::PackNistDatabase(folder, packed_file)) return 1;
+  
+  // Check that the packed file can be mapped
+  solutio::PackedNistDatabase database;
+  if(!database.Open(packed_file)) return 1;
+  std::cout << "Packed " << database.GetNumMaterials() << " materials from \"" <<
+      folder << "\" into \"" << packed_file << "\" (version " <<
+      solutio::kNistPackVersion << ")\n";
+
+  // Return if success
+  return 0;
+}
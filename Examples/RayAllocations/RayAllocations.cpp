@@ -0,0 +1,185 @@
+/******************************************************************************/
+/*                                                                            */
+/* Copyright 2016-2017 Steven Dolly                                           */
+/*                                                                            */
+/* Licensed under the Apache License, Version 2.0 (the "License");            */
+/* you may not use this file except in compliance with the License.           */
+/* You may obtain a copy of the License at:                                   */
+/*                                                                            */
+/*     http://www.apache.org/licenses/LICENSE-2.0                             */
+/*                                                                            */
+/* Unless required by applicable law or agreed to in writing, software        */
+/* distributed under the License is distributed on an "AS IS" BASIS,          */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   */
+/* See the License for the specific language governing permissions and        */
+/* limitations under the License.                                             */
+/*                                                                            */
+/******************************************************************************/
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// RayAllocations.cpp                                                         //
+// Ray Attenuation Allocation Benchmark                                       //
+// Created October 15, 2026                                                   //
+//                                                                            //
+// This program counts the heap allocations made while tracing rays through   //
+// an object model with many inclusions, using the single-ray and batched     //
+// attenuation functions, with and without the bounding-volume hierarchy.     //
+// After the scratch buffers have grown, every ray should allocate nothing:   //
+//                                                                            //
+//   RayAllocations <NISTX folder> [number of inclusions]                     //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// C++ headers
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+// Solutio library headers
+#include "Geometry/Cylinder.hpp"
+#include "Geometry/RayBatch.hpp"
+#include "Imaging/ObjectModelXray.hpp"
+#include "Imaging/Tasmip.hpp"
+
+// Count every allocation made through the global operator new
+static std::atomic<long> num_allocations(0);
+
+void *operator new(std::size_t size)
+{
+  num_allocations++;
+  void *p = std::malloc(size == 0 ? 1 : size);
+  if(p == 0) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void *p) noexcept
+{
+  std::free(p);
+}
+
+// Fan of rays from a source on a circle, crossing the model
+static solutio::Ray3 FanRay(int view, int channel, int num_channels)
+{
+  double a = 2.0*M_PI*view/90.0;
+  double b = a + 0.5*(double(channel)/num_channels - 0.5);
+  solutio::Vec3<double> source(54.0*cos(a), 54.0*sin(a), 0.0);
+  solutio::Vec3<double> direction(-108.0*cos(b), -108.0*sin(b), 0.0);
+  return solutio::Ray3(source, direction);
+}
+
+int main(int argc, char *argv[])
+{
+  if(argc < 2)
+  {
+    std::cout << "Usage: RayAllocations <NISTX folder> [number of " <<
+        "inclusions]\n";
+    return 1;
+  }
+  std::string folder = argv[1];
+  int num_inclusions = (argc > 2) ? atoi(argv[2]) : 1000;
+  int num_views = 90, num_channels = 256;
+  
+  // Water cylinder with a grid of small bone inclusions
+  std::vector<solutio::Cylinder> objects;
+  objects.reserve(num_inclusions + 2);
+  objects.push_back(solutio::Cylinder(solutio::Vec3<double>(0, 0, 0), 60.0,
+      100.0));
+  objects.push_back(solutio::Cylinder(solutio::Vec3<double>(0, 0, 0), 20.0,
+      30.0));
+  int side = int(sqrt(double(num_inclusions))) + 1;
+  for(int n = 0; n < num_inclusions; n++)
+  {
+    double x = -14.0 + 28.0*(n % side + 0.5)/side;
+    double y = -14.0 + 28.0*(n / side + 0.5)/side;
+    objects.push_back(solutio::Cylinder(solutio::Vec3<double>(x, y, 0),
+        0.2*14.0/side, 30.0));
+  }
+  std::vector<double> spectrum = solutio::Tasmip(120, 0.0, "Aluminum",
+      folder);
+  
+  for(int use_bvh = 0; use_bvh < 2; use_bvh++)
+  {
+    solutio::ObjectModelXray M;
+    M.AddMaterial(folder, "Air, Dry (near sea level)");
+    M.AddMaterial(folder, "Water, Liquid");
+    M.AddMaterial(folder, "Bone, Cortical (ICRU-44)");
+    M.AddObject("World", objects[0], "None", "Air, Dry (near sea level)");
+    M.AddObject("Body", objects[1], "World", "Water, Liquid");
+    for(int n = 0; n < num_inclusions; n++)
+    {
+      M.AddObject("Inclusion " + std::to_string(n), objects[(n+2)], "Body",
+          "Bone, Cortical (ICRU-44)");
+    }
+    M.MakeTree(use_bvh != 0);
+    
+    // Single rays (a first sweep grows the scratch buffers)
+    solutio::XrayRayScratch scratch;
+    double checksum = 0.0;
+    for(int v = 0; v < num_views; v++)
+    {
+      for(int c = 0; c < num_channels; c++)
+      {
+        M.GetRayAttenuation(FanRay(v, c, num_channels), spectrum, scratch);
+      }
+    }
+    long start_count = num_allocations;
+    std::chrono::steady_clock::time_point t0 =
+        std::chrono::steady_clock::now();
+    for(int v = 0; v < num_views; v++)
+    {
+      for(int c = 0; c < num_channels; c++)
+      {
+        checksum += M.GetRayAttenuation(FanRay(v, c, num_channels), spectrum,
+            scratch);
+      }
+    }
+    std::chrono::steady_clock::time_point t1 =
+        std::chrono::steady_clock::now();
+    long single_allocations = num_allocations - start_count;
+    
+    // Batches of one view each
+    solutio::RayBatch rays(num_channels);
+    std::vector<double> attenuations(num_channels);
+    for(int v = 0; v < num_views; v++)
+    {
+      for(int c = 0; c < num_channels; c++)
+      {
+        rays.SetRay(c, FanRay(v, c, num_channels));
+      }
+      M.GetRayAttenuations(rays, spectrum, &attenuations[0], scratch);
+    }
+    start_count = num_allocations;
+    std::chrono::steady_clock::time_point t2 =
+        std::chrono::steady_clock::now();
+    for(int v = 0; v < num_views; v++)
+    {
+      for(int c = 0; c < num_channels; c++)
+      {
+        rays.SetRay(c, FanRay(v, c, num_channels));
+      }
+      M.GetRayAttenuations(rays, spectrum, &attenuations[0], scratch);
+      checksum += attenuations[0];
+    }
+    std::chrono::steady_clock::time_point t3 =
+        std::chrono::steady_clock::now();
+    long batch_allocations = num_allocations - start_count;
+    
+    double num_rays = double(num_views)*num_channels;
+    std::cout << (use_bvh ? "With BVH" : "Without BVH") << " (" <<
+        num_inclusions << " inclusions, checksum " << checksum << ")\n";
+    std::cout << "  Single rays:  " << single_allocations/num_rays <<
+        " allocations/ray, " << num_rays /
+        std::chrono::duration<double>(t1 - t0).count() << " rays/s\n";
+    std::cout << "  Ray batches:  " << batch_allocations/num_rays <<
+        " allocations/ray, " << num_rays /
+        std::chrono::duration<double>(t3 - t2).count() << " rays/s\n";
+  }
+  
+  // Return if success
+  return 0;
+}
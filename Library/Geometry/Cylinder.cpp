@@ -33,10 +33,36 @@
 
 // C Headers
 #include <cmath>
+#include <algorithm>
 #include <iostream>
 
+// Vector intrinsics (only used when the compiler targets AVX2/AVX-512)
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
 namespace solutio
 {
+  // Length of the segment origin + t*direction, t in [0, 1], inside an
+  // infinite cylinder along z, with the origin shifted to the cylinder axis.
+  // Segments that miss (or run parallel to the axis) give 0.
+  static inline double CylinderChord(double ux, double uy, double dx,
+      double dy, double dz, double radius)
+  {
+    double q_a = dx*dx + dy*dy;
+    double q_b = 2.0*(dx*ux + dy*uy);
+    double q_c = ux*ux + uy*uy - radius*radius;
+    double q_check = q_b*q_b - 4.0*q_a*q_c;
+    if(!(q_check >= 0.0) || !(q_a > 0.0)) return 0.0;
+    double root = sqrt(q_check);
+    double solution_0 = (-q_b + root) / (2.0*q_a);
+    double solution_1 = (-q_b - root) / (2.0*q_a);
+    double t_in = std::max(std::min(solution_0, solution_1), 0.0);
+    double t_out = std::min(std::max(solution_0, solution_1), 1.0);
+    double L = sqrt(dx*dx + dy*dy + dz*dz);
+    return (L * std::max(t_out - t_in, 0.0));
+  }
+
   Cylinder::Cylinder(Vec3<double> c, double r, double h)
   {
     centroid = c;
@@ -52,28 +78,110 @@ namespace solutio
   
   double Cylinder::RayPathlength(Ray3 ray)
   {
-    double solution[2];
-    double L = ray.direction.Magnitude();
-    // Calculate coefficients for the quadratic equation
-    double q_a = pow(ray.direction.x,2) + pow(ray.direction.y,2);
-    double q_b = 2*ray.direction.x*(ray.origin.x-centroid.x) +
-        2*(ray.direction.y*(ray.origin.y - centroid.y));
-    double q_c = pow((ray.origin.x-centroid.x),2) + pow((ray.origin.y-centroid.y),2) - pow(radius,2);
-    double q_check = pow(q_b,2) - 4*q_a*q_c;
-    // No solution
-    if(q_check < 0.0) return 0.0;
-    // One or two solutions
-    else
+    return CylinderChord(ray.origin.x - centroid.x, ray.origin.y - centroid.y,
+        ray.direction.x, ray.direction.y, ray.direction.z, radius);
+  }
+
+  // Ray intersections ignore the height, so the box is unbounded in z
+  bool Cylinder::GetBounds(Vec3<double> &lower, Vec3<double> &upper)
+  {
+    lower.Set(centroid.x - radius, centroid.y - radius, -HUGE_VAL);
+    upper.Set(centroid.x + radius, centroid.y + radius, HUGE_VAL);
+    return true;
+  }
+
+  // Same calculation as CylinderChord, several rays at a time; the branches
+  // are replaced by compare-and-blend so every lane follows the same path
+  void Cylinder::RayPathlengths(const RayBatch &rays, double *pathlengths)
+  {
+    int num_rays = rays.Size();
+    const double *ox = rays.origin_x.data(), *oy = rays.origin_y.data();
+    const double *dx = rays.direction_x.data();
+    const double *dy = rays.direction_y.data();
+    const double *dz = rays.direction_z.data();
+    int n = 0;
+#if defined(__AVX512F__)
+    {
+      __m512d cx = _mm512_set1_pd(centroid.x);
+      __m512d cy = _mm512_set1_pd(centroid.y);
+      __m512d r2 = _mm512_set1_pd(radius*radius);
+      __m512d two = _mm512_set1_pd(2.0), four = _mm512_set1_pd(4.0);
+      __m512d zero = _mm512_setzero_pd(), one = _mm512_set1_pd(1.0);
+      for(; n + 8 <= num_rays; n += 8)
+      {
+        __m512d ux = _mm512_sub_pd(_mm512_loadu_pd(ox + n), cx);
+        __m512d uy = _mm512_sub_pd(_mm512_loadu_pd(oy + n), cy);
+        __m512d vx = _mm512_loadu_pd(dx + n);
+        __m512d vy = _mm512_loadu_pd(dy + n);
+        __m512d vz = _mm512_loadu_pd(dz + n);
+        __m512d q_a = _mm512_add_pd(_mm512_mul_pd(vx, vx),
+            _mm512_mul_pd(vy, vy));
+        __m512d q_b = _mm512_mul_pd(two, _mm512_add_pd(_mm512_mul_pd(vx, ux),
+            _mm512_mul_pd(vy, uy)));
+        __m512d d2 = _mm512_add_pd(_mm512_mul_pd(ux, ux),
+            _mm512_mul_pd(uy, uy));
+        __m512d q_c = _mm512_sub_pd(d2, r2);
+        __m512d q_check = _mm512_sub_pd(_mm512_mul_pd(q_b, q_b),
+            _mm512_mul_pd(four, _mm512_mul_pd(q_a, q_c)));
+        __mmask8 valid = _mm512_cmp_pd_mask(q_check, zero, _CMP_GE_OQ) &
+            _mm512_cmp_pd_mask(q_a, zero, _CMP_GT_OQ);
+        __m512d root = _mm512_sqrt_pd(_mm512_max_pd(q_check, zero));
+        __m512d denom = _mm512_mul_pd(two, q_a);
+        __m512d s0 = _mm512_div_pd(_mm512_sub_pd(root, q_b), denom);
+        __m512d s1 = _mm512_div_pd(_mm512_sub_pd(_mm512_sub_pd(zero, q_b),
+            root), denom);
+        __m512d t_in = _mm512_max_pd(_mm512_min_pd(s0, s1), zero);
+        __m512d t_out = _mm512_min_pd(_mm512_max_pd(s0, s1), one);
+        __m512d L = _mm512_sqrt_pd(_mm512_add_pd(q_a, _mm512_mul_pd(vz, vz)));
+        __m512d chord = _mm512_max_pd(_mm512_sub_pd(t_out, t_in), zero);
+        _mm512_storeu_pd(pathlengths + n, _mm512_maskz_mul_pd(valid, L, chord));
+      }
+    }
+#endif
+#if defined(__AVX2__)
     {
-      solution[0] = (-q_b + sqrt(q_check)) / (2*q_a);
-      solution[1] = (-q_b - sqrt(q_check)) / (2*q_a);
-      double d_center = sqrt(pow(ray.origin.x-centroid.x,2.0)+pow(ray.origin.y-centroid.y,2.0));
-      if(d_center < radius)
+      __m256d cx = _mm256_set1_pd(centroid.x);
+      __m256d cy = _mm256_set1_pd(centroid.y);
+      __m256d r2 = _mm256_set1_pd(radius*radius);
+      __m256d two = _mm256_set1_pd(2.0), four = _mm256_set1_pd(4.0);
+      __m256d zero = _mm256_setzero_pd(), one = _mm256_set1_pd(1.0);
+      for(; n + 4 <= num_rays; n += 4)
       {
-        double positive_value = std::max(solution[0], solution[1]);
-        return (L * positive_value);
+        __m256d ux = _mm256_sub_pd(_mm256_loadu_pd(ox + n), cx);
+        __m256d uy = _mm256_sub_pd(_mm256_loadu_pd(oy + n), cy);
+        __m256d vx = _mm256_loadu_pd(dx + n);
+        __m256d vy = _mm256_loadu_pd(dy + n);
+        __m256d vz = _mm256_loadu_pd(dz + n);
+        __m256d q_a = _mm256_add_pd(_mm256_mul_pd(vx, vx),
+            _mm256_mul_pd(vy, vy));
+        __m256d q_b = _mm256_mul_pd(two, _mm256_add_pd(_mm256_mul_pd(vx, ux),
+            _mm256_mul_pd(vy, uy)));
+        __m256d d2 = _mm256_add_pd(_mm256_mul_pd(ux, ux),
+            _mm256_mul_pd(uy, uy));
+        __m256d q_c = _mm256_sub_pd(d2, r2);
+        __m256d q_check = _mm256_sub_pd(_mm256_mul_pd(q_b, q_b),
+            _mm256_mul_pd(four, _mm256_mul_pd(q_a, q_c)));
+        __m256d valid = _mm256_and_pd(
+            _mm256_cmp_pd(q_check, zero, _CMP_GE_OQ),
+            _mm256_cmp_pd(q_a, zero, _CMP_GT_OQ));
+        __m256d root = _mm256_sqrt_pd(_mm256_max_pd(q_check, zero));
+        __m256d denom = _mm256_mul_pd(two, q_a);
+        __m256d s0 = _mm256_div_pd(_mm256_sub_pd(root, q_b), denom);
+        __m256d s1 = _mm256_div_pd(_mm256_sub_pd(_mm256_sub_pd(zero, q_b),
+            root), denom);
+        __m256d t_in = _mm256_max_pd(_mm256_min_pd(s0, s1), zero);
+        __m256d t_out = _mm256_min_pd(_mm256_max_pd(s0, s1), one);
+        __m256d L = _mm256_sqrt_pd(_mm256_add_pd(q_a, _mm256_mul_pd(vz, vz)));
+        __m256d chord = _mm256_max_pd(_mm256_sub_pd(t_out, t_in), zero);
+        _mm256_storeu_pd(pathlengths + n,
+            _mm256_and_pd(valid, _mm256_mul_pd(L, chord)));
       }
-      else return (L * fabs(solution[0]-solution[1]));
+    }
+#endif
+    for(; n < num_rays; n++)
+    {
+      pathlengths[n] = CylinderChord(ox[n] - centroid.x, oy[n] - centroid.y,
+          dx[n], dy[n], dz[n], radius);
     }
   }
 }
@@ -50,6 +50,8 @@ namespace solutio
       // Calc functions
       double CalcVolume();
       double RayPathlength(Ray3 ray);
+      void RayPathlengths(const RayBatch &rays, double *pathlengths);
+      bool GetBounds(Vec3<double> &lower, Vec3<double> &upper);
     private:
       double radius;
       double height;
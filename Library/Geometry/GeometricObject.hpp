@@ -34,13 +34,31 @@
 
 // Custom headers
 #include "Ray3.hpp"
+#include "RayBatch.hpp"
 
 namespace solutio
 {
   class GeometricObject
   {
     public:
+      // Length of the segment from ray.origin to ray.origin + ray.direction
+      // inside the object
       virtual double RayPathlength(Ray3 ray){ return 0.0; };
+      // Path lengths for a whole batch of rays; objects with a vectorized
+      // intersection should override this
+      virtual void RayPathlengths(const RayBatch &rays, double *pathlengths)
+      {
+        for(int n = 0; n < rays.Size(); n++)
+        {
+          pathlengths[n] = RayPathlength(rays.GetRay(n));
+        }
+      };
+      // Axis-aligned box containing every point a ray can be counted through;
+      // returns false for objects without finite bounds
+      virtual bool GetBounds(Vec3<double> &lower, Vec3<double> &upper)
+      {
+        return false;
+      };
     protected:
       Vec3<double> centroid;
       double volume;
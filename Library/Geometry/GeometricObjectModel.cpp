@@ -32,10 +32,42 @@
 #include "GeometricObjectModel.hpp"
 
 // C++ headers
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 namespace solutio
 {
+  // Whether the infinite line through a ray crosses a box (slab test); a
+  // conservative test, as path lengths only count the ray's segment
+  static bool LineHitsBox(const double origin[3], const double direction[3],
+      const BvhNode &node)
+  {
+    double lower[3] = {node.lower.x, node.lower.y, node.lower.z};
+    double upper[3] = {node.upper.x, node.upper.y, node.upper.z};
+    double t_min = -HUGE_VAL, t_max = HUGE_VAL;
+    for(int i = 0; i < 3; i++)
+    {
+      if(direction[i] == 0.0)
+      {
+        if(origin[i] < lower[i] || origin[i] > upper[i]) return false;
+        continue;
+      }
+      double t0 = (lower[i] - origin[i]) / direction[i];
+      double t1 = (upper[i] - origin[i]) / direction[i];
+      if(t0 > t1) std::swap(t0, t1);
+      t_min = std::max(t_min, t0);
+      t_max = std::min(t_max, t1);
+    }
+    return (t_min <= t_max);
+  }
+
+  GeometricObjectModel::GeometricObjectModel()
+  {
+    world_id = 0;
+    use_bvh = false;
+  }
+
   void GeometricObjectModel::AssignParent(std::string parent)
   {
     bool found = false;
@@ -67,9 +99,10 @@ namespace solutio
     object_pointers.push_back(&G);
   }
   // Create tree structure given all parent-child object relations
-  void GeometricObjectModel::MakeTree()
+  void GeometricObjectModel::MakeTree(bool build_bvh)
   {
     int level, num_levels = 1, new_parent;
+    object_levels.clear();
     // Determine number of levels
     for(int n = 0; n < object_name.size(); n++)
     {
@@ -111,6 +144,178 @@ namespace solutio
       }
       object_levels.push_back(current_level);
     }
+    // Flatten the levels so candidate lists can be kept in level order
+    level_order.clear();
+    object_rank.assign(object_name.size(), -1);
+    for(int m = 1; m < object_levels.size(); m++)
+    {
+      for(int n = 0; n < object_levels[m].size(); n++)
+      {
+        object_rank[(object_levels[m][n])] = level_order.size();
+        level_order.push_back(object_levels[m][n]);
+      }
+    }
+    use_bvh = build_bvh;
+    if(use_bvh) BuildBvh();
+  }
+
+  void GeometricObjectModel::BuildBvh()
+  {
+    int num_objects = object_name.size();
+    std::vector< Vec3<double> > lower(num_objects), upper(num_objects),
+        center(num_objects);
+    bvh_nodes.clear();
+    bvh_objects.clear();
+    unbounded_objects.clear();
+    for(int k = 0; k < level_order.size(); k++)
+    {
+      int id = level_order[k];
+      Vec3<double> lo, hi;
+      if(!object_pointers[id]->GetBounds(lo, hi) || !(lo.x <= hi.x) ||
+          !(lo.y <= hi.y) || !(lo.z <= hi.z))
+      {
+        unbounded_objects.push_back(id);
+        continue;
+      }
+      // Pad the box so rays grazing an object are never culled
+      double pad = 1.0e-6;
+      lower[id].Set(lo.x - pad, lo.y - pad, lo.z - pad);
+      upper[id].Set(hi.x + pad, hi.y + pad, hi.z + pad);
+      // Split on box centers, treating infinite extents as centered on 0
+      center[id].Set(std::isfinite(lo.x + hi.x) ? 0.5*(lo.x + hi.x) : 0.0,
+          std::isfinite(lo.y + hi.y) ? 0.5*(lo.y + hi.y) : 0.0,
+          std::isfinite(lo.z + hi.z) ? 0.5*(lo.z + hi.z) : 0.0);
+      bvh_objects.push_back(id);
+    }
+    if(bvh_objects.size() > 0)
+    {
+      BuildBvhNode(0, bvh_objects.size(), lower, upper, center);
+    }
+  }
+
+  // Build a node over bvh_objects[first ... first+count-1], splitting at the
+  // median center along the axis where the centers are most spread out
+  int GeometricObjectModel::BuildBvhNode(int first, int count,
+      const std::vector< Vec3<double> > &lower,
+      const std::vector< Vec3<double> > &upper,
+      const std::vector< Vec3<double> > &center)
+  {
+    const int max_leaf_size = 4;
+    BvhNode node;
+    node.lower = lower[(bvh_objects[first])];
+    node.upper = upper[(bvh_objects[first])];
+    Vec3<double> c_min = center[(bvh_objects[first])];
+    Vec3<double> c_max = c_min;
+    for(int n = first + 1; n < first + count; n++)
+    {
+      int id = bvh_objects[n];
+      node.lower.Set(std::min(node.lower.x, lower[id].x),
+          std::min(node.lower.y, lower[id].y),
+          std::min(node.lower.z, lower[id].z));
+      node.upper.Set(std::max(node.upper.x, upper[id].x),
+          std::max(node.upper.y, upper[id].y),
+          std::max(node.upper.z, upper[id].z));
+      c_min.Set(std::min(c_min.x, center[id].x),
+          std::min(c_min.y, center[id].y), std::min(c_min.z, center[id].z));
+      c_max.Set(std::max(c_max.x, center[id].x),
+          std::max(c_max.y, center[id].y), std::max(c_max.z, center[id].z));
+    }
+    node.left = node.right = -1;
+    node.first = first;
+    node.count = count;
+    int node_id = bvh_nodes.size();
+    bvh_nodes.push_back(node);
+    
+    double extent[3] = {c_max.x - c_min.x, c_max.y - c_min.y,
+        c_max.z - c_min.z};
+    int axis = 0;
+    if(extent[1] > extent[axis]) axis = 1;
+    if(extent[2] > extent[axis]) axis = 2;
+    if(count <= max_leaf_size || extent[axis] <= 0.0) return node_id;
+    
+    int half = count/2;
+    std::nth_element(bvh_objects.begin() + first,
+        bvh_objects.begin() + first + half,
+        bvh_objects.begin() + first + count, [&](int a, int b)
+    {
+      if(axis == 0) return (center[a].x < center[b].x);
+      else if(axis == 1) return (center[a].y < center[b].y);
+      else return (center[a].z < center[b].z);
+    });
+    int left = BuildBvhNode(first, half, lower, upper, center);
+    int right = BuildBvhNode(first + half, count - half, lower, upper, center);
+    bvh_nodes[node_id].left = left;
+    bvh_nodes[node_id].right = right;
+    bvh_nodes[node_id].count = 0;
+    return node_id;
+  }
+
+  template <class F>
+  void GeometricObjectModel::CollectCandidates(F box_hit,
+      std::vector<int> &candidates)
+  {
+    if(!use_bvh)
+    {
+      candidates = level_order;
+      return;
+    }
+    candidates = unbounded_objects;
+    if(bvh_nodes.size() > 0)
+    {
+      // Median splits keep the depth below 32, so a fixed stack is enough
+      int stack[64], stack_size = 0;
+      stack[stack_size++] = 0;
+      while(stack_size > 0)
+      {
+        const BvhNode &node = bvh_nodes[(stack[--stack_size])];
+        if(!box_hit(node)) continue;
+        if(node.left < 0)
+        {
+          candidates.insert(candidates.end(), bvh_objects.begin() + node.first,
+              bvh_objects.begin() + node.first + node.count);
+        }
+        else
+        {
+          stack[stack_size++] = node.right;
+          stack[stack_size++] = node.left;
+        }
+      }
+    }
+    // Children must be visited after their parents
+    std::sort(candidates.begin(), candidates.end(), [this](int a, int b)
+    {
+      return (object_rank[a] < object_rank[b]);
+    });
+  }
+
+  void GeometricObjectModel::FindCandidates(Ray3 ray,
+      std::vector<int> &candidates)
+  {
+    double origin[3] = {ray.origin.x, ray.origin.y, ray.origin.z};
+    double direction[3] = {ray.direction.x, ray.direction.y,
+        ray.direction.z};
+    CollectCandidates([&](const BvhNode &node)
+    {
+      return LineHitsBox(origin, direction, node);
+    }, candidates);
+  }
+
+  void GeometricObjectModel::FindCandidates(const RayBatch &rays,
+      std::vector<int> &candidates)
+  {
+    // A node is visited if any ray of the batch crosses it
+    CollectCandidates([&](const BvhNode &node)
+    {
+      for(int n = 0; n < rays.Size(); n++)
+      {
+        double origin[3] = {rays.origin_x[n], rays.origin_y[n],
+            rays.origin_z[n]};
+        double direction[3] = {rays.direction_x[n], rays.direction_y[n],
+            rays.direction_z[n]};
+        if(LineHitsBox(origin, direction, node)) return true;
+      }
+      return false;
+    }, candidates);
   }
   
   std::vector< std::pair<int, double> > GeometricObjectModel::CalcRayPathlength(Ray3 ray)
@@ -138,31 +343,30 @@ namespace solutio
       ray_object_ids.push_back(world_id);
       ray_intersect[0] = true;
     }
-    // Loop for each subsequent level
-    for(int m = 1; m < object_levels.size(); m++)
+    // Loop over the objects the ray might hit, level by level
+    std::vector<int> candidates;
+    FindCandidates(ray, candidates);
+    for(int k = 0; k < candidates.size(); k++)
     {
-      for(int n = 0; n < object_levels[m].size(); n++)
+      int id = candidates[k];
+      if(!ray_intersect[(object_parent[id])]) continue;
+      // Check if ray intersects with any children
+      length = object_pointers[id]->RayPathlength(ray);
+      
+      // Save material IDs and path lengths for children, subtract pathlengths
+      // from parents
+      if(length > 1.0e-10)
       {
-        if(!ray_intersect[(object_parent[(object_levels[m][n])])]) continue;
-        // Check if ray intersects with any children
-        length = object_pointers[(object_levels[m][n])]->RayPathlength(ray);
+        pathlengths.push_back(length);
+        ray_object_ids.push_back(id);
+        ray_intersect[id] = true;
+        
+        parent_id = 0;
+        while(object_parent[id] != ray_object_ids[parent_id]) parent_id++;
+        pathlengths[parent_id] -= length;
         
-        // Save material IDs and path lengths for children, subtract pathlengths
-        // from parents
-        if(length > 1.0e-10)
-        {
-          pathlengths.push_back(length);
-          ray_object_ids.push_back((object_levels[m][n]));
-          ray_intersect[(object_levels[m][n])] = true;
-          
-          parent_id = 0;
-          while(object_parent[(object_levels[m][n])] !=
-              ray_object_ids[parent_id]) parent_id++;
-          pathlengths[parent_id] -= length;
-          
-        }
-        else { ray_intersect[(object_levels[m][n])] = false; }
       }
+      else { ray_intersect[id] = false; }
     }
     for(int n = 0; n < pathlengths.size(); n++){
       list_entry.first = ray_object_ids[n];
@@ -39,24 +39,60 @@
 // Custom headers
 #include "GeometricObject.hpp"
 #include "Ray3.hpp"
+#include "RayBatch.hpp"
+#include "Vec3.hpp"
 
 namespace solutio
 {
+  // Node of the bounding-volume hierarchy over a model's objects
+  struct BvhNode
+  {
+    Vec3<double> lower, upper;
+    // Child nodes (-1 for a leaf)
+    int left, right;
+    // Range of bvh_objects held by a leaf
+    int first, count;
+  };
+
   class GeometricObjectModel
   {
     public:
+      GeometricObjectModel();
       virtual void AddGeometricObject(std::string name, GeometricObject &G,
           std::string parent_name);
-      void MakeTree();
+      // Sort objects into levels, optionally building a bounding-volume
+      // hierarchy so rays only test objects whose bounds they cross
+      void MakeTree(bool build_bvh = false);
+      bool HasBvh(){ return use_bvh; }
       std::vector< std::pair<int, double> > CalcRayPathlength(Ray3 ray);
     protected:
       void AssignParent(std::string parent);
+      // Objects (world excluded) that a ray, or any ray of a batch, might
+      // intersect, in level order (parents before children)
+      void FindCandidates(Ray3 ray, std::vector<int> &candidates);
+      void FindCandidates(const RayBatch &rays, std::vector<int> &candidates);
       std::vector<std::string> object_name;
       std::vector<std::string> object_type;
       std::vector<int> object_parent;
       int world_id;
       std::vector<GeometricObject *> object_pointers;
       std::vector< std::vector<int> > object_levels;
+      // Objects in level order (world excluded) and each object's position
+      std::vector<int> level_order;
+      std::vector<int> object_rank;
+      // Bounding-volume hierarchy (node 0 is the root)
+      bool use_bvh;
+      std::vector<BvhNode> bvh_nodes;
+      std::vector<int> bvh_objects;
+      std::vector<int> unbounded_objects;
+    private:
+      void BuildBvh();
+      int BuildBvhNode(int first, int count,
+          const std::vector< Vec3<double> > &lower,
+          const std::vector< Vec3<double> > &upper,
+          const std::vector< Vec3<double> > &center);
+      template <class F>
+      void CollectCandidates(F box_hit, std::vector<int> &candidates);
   };
 }
 
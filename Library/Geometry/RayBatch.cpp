@@ -0,0 +1,74 @@
+/******************************************************************************/
+/*                                                                            */
+/* Copyright 2016-2017 Steven Dolly                                           */
+/*                                                                            */
+/* Licensed under the Apache License, Version 2.0 (the "License");            */
+/* you may not use this file except in compliance with the License.           */
+/* You may obtain a copy of the License at:                                   */
+/*                                                                            */
+/*     http://www.apache.org/licenses/LICENSE-2.0                             */
+/*                                                                            */
+/* Unless required by applicable law or agreed to in writing, software        */
+/* distributed under the License is distributed on an "AS IS" BASIS,          */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   */
+/* See the License for the specific language governing permissions and        */
+/* limitations under the License.                                             */
+/*                                                                            */
+/******************************************************************************/
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// RayBatch.cpp                                                               //
+// Structure-of-Arrays Ray Batch Class Source File                            //
+// Created October 15, 2026                                                   //
+//                                                                            //
+// This file contains the source code for a class holding a block of 3D rays  //
+// as separate x/y/z component arrays.                                        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// Class header
+#include "RayBatch.hpp"
+
+namespace solutio
+{
+  // Default constructor (empty batch)
+  RayBatch::RayBatch()
+  {
+    num_rays = 0;
+  }
+  // Constructor with number of rays (set to all zeros)
+  RayBatch::RayBatch(int n)
+  {
+    num_rays = 0;
+    Resize(n);
+  }
+  // Set functions
+  void RayBatch::Resize(int n)
+  {
+    num_rays = n;
+    origin_x.resize(n);
+    origin_y.resize(n);
+    origin_z.resize(n);
+    direction_x.resize(n);
+    direction_y.resize(n);
+    direction_z.resize(n);
+  }
+
+  void RayBatch::SetRay(int n, Ray3 ray)
+  {
+    origin_x[n] = ray.origin.x;
+    origin_y[n] = ray.origin.y;
+    origin_z[n] = ray.origin.z;
+    direction_x[n] = ray.direction.x;
+    direction_y[n] = ray.direction.y;
+    direction_z[n] = ray.direction.z;
+  }
+  // Get functions
+  Ray3 RayBatch::GetRay(int n) const
+  {
+    Vec3<double> o(origin_x[n], origin_y[n], origin_z[n]);
+    Vec3<double> d(direction_x[n], direction_y[n], direction_z[n]);
+    return Ray3(o, d);
+  }
+}
@@ -0,0 +1,65 @@
+/******************************************************************************/
+/*                                                                            */
+/* Copyright 2016-2017 Steven Dolly                                           */
+/*                                                                            */
+/* Licensed under the Apache License, Version 2.0 (the "License");            */
+/* you may not use this file except in compliance with the License.           */
+/* You may obtain a copy of the License at:                                   */
+/*                                                                            */
+/*     http://www.apache.org/licenses/LICENSE-2.0                             */
+/*                                                                            */
+/* Unless required by applicable law or agreed to in writing, software        */
+/* distributed under the License is distributed on an "AS IS" BASIS,          */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   */
+/* See the License for the specific language governing permissions and        */
+/* limitations under the License.                                             */
+/*                                                                            */
+/******************************************************************************/
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// RayBatch.hpp                                                               //
+// Structure-of-Arrays Ray Batch Header File                                  //
+// Created October 15, 2026                                                   //
+//                                                                            //
+// This header file contains a class for a block of double-precision 3D rays, //
+// stored as separate x/y/z arrays for the origins and directions, so that    //
+// geometric objects can intersect many rays per call with vector code.       //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// Header guard
+#ifndef RAYBATCH_HPP
+#define RAYBATCH_HPP
+
+// Standard C++ header files
+#include <vector>
+
+// Custom headers
+#include "Ray3.hpp"
+
+namespace solutio
+{
+  class RayBatch
+  {
+    public:
+      // Default constructor (empty batch)
+      RayBatch();
+      // Constructor with number of rays (set to all zeros)
+      RayBatch(int n);
+      // Set functions
+      void Resize(int n);
+      void SetRay(int n, Ray3 ray);
+      // Get functions
+      int Size() const { return num_rays; }
+      Ray3 GetRay(int n) const;
+      // Ray origins & directions, one array per component
+      std::vector<double> origin_x, origin_y, origin_z;
+      std::vector<double> direction_x, direction_y, direction_z;
+    private:
+      int num_rays;
+  };
+}
+
+// End header guard
+#endif
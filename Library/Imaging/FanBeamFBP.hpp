@@ -0,0 +1,98 @@
+/******************************************************************************/
+/*                                                                            */
+/* Copyright 2016-2017 Steven Dolly                                           */
+/*                                                                            */
+/* Licensed under the Apache License, Version 2.0 (the "License");            */
+/* you may not use this file except in compliance with the License.           */
+/* You may obtain a copy of the License at:                                   */
+/*                                                                            */
+/*     http://www.apache.org/licenses/LICENSE-2.0                             */
+/*                                                                            */
+/* Unless required by applicable law or agreed to in writing, software        */
+/* distributed under the License is distributed on an "AS IS" BASIS,          */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   */
+/* See the License for the specific language governing permissions and        */
+/* limitations under the License.                                             */
+/*                                                                            */
+/******************************************************************************/
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// FanBeamFBP.hpp                                                             //
+// Fan-Beam Filtered Backprojection Class Header File                         //
+// Created October 15, 2026                                                   //
+//                                                                            //
+// This header file contains the class for filtered backprojection (FBP)      //
+// reconstruction of axial CT data acquired with RayCT. The projections are   //
+// equiangular fan beams over a full rotation, laid out as views x rows x     //
+// channels, and each detector row is reconstructed as its own slice.         //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// Header guard
+#ifndef FANBEAMFBP_HPP
+#define FANBEAMFBP_HPP
+
+// Standard C++ header files
+#include <complex>
+#include <string>
+#include <vector>
+
+namespace solutio
+{
+  class FanBeamFBP
+  {
+    public:
+      FanBeamFBP();
+      // Scanner geometry, with the same parameters as RayCT::SetGeometry
+      void SetGeometry(double radius, int n_c, double d_c, int n_r, double d_r);
+      void SetNumProjections(int projs);
+      // Square image of size x size pixels, centered on the isocenter
+      void SetImage(int size, double pixel);
+      // Apodization of the ramp filter: "Ram-Lak", "Shepp-Logan" or "Hann"
+      bool SetFilterWindow(std::string window);
+      // Parallel backprojection settings (0 threads = all hardware threads)
+      void SetNumThreads(int threads);
+      void SetImageTile(int size);
+      // Line integrals ln(I0/I) from raw projections and an air scan (rows x
+      // channels)
+      std::vector<double> LineIntegrals(const std::vector<double> &projections,
+          const std::vector<double> &air_scan);
+      // Filter the views of one detector row; output is padded and scaled
+      // ready for Backproject
+      bool FilterProjections(const std::vector<double> &line_integrals,
+          int row, std::vector<float> &filtered);
+      // Add filtered views into a preallocated image (size*size values, row
+      // by row); the image is not cleared first
+      bool Backproject(const std::vector<float> &filtered, float *image);
+      // Filter and backproject one detector row into a preallocated image
+      bool ReconstructSlice(const std::vector<double> &line_integrals,
+          int row, float *image);
+    private:
+      void MakeFilterKernel();
+      void BackprojectTile(const std::vector<float> &filtered, int x_begin,
+          int x_end, int y_begin, int y_end, float *image);
+      // Scanner geometry parameters
+      double scanner_radius;
+      int num_channels;
+      double channel_width;
+      int num_rows;
+      double row_width;
+      int num_projections;
+      double fan_angle;
+      double d_fan_angle;
+      // Image parameters
+      int image_size;
+      double pixel_size;
+      // Filter (frequency response of the fan-beam ramp kernel)
+      std::string filter_window;
+      int filter_size;
+      std::vector< std::complex<double> > filter_response;
+      // Parallel backprojection parameters
+      int num_threads;
+      int tile_size;
+  };
+}
+
+// End header guard
+#endif
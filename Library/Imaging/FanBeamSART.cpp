@@ -0,0 +1,397 @@
+/******************************************************************************/
+/*                                                                            */
+/* Copyright 2016-2017 Steven Dolly                                           */
+/*                                                                            */
+/* Licensed under the Apache License, Version 2.0 (the "License");            */
+/* you may not use this file except in compliance with the License.           */
+/* You may obtain a copy of the License at:                                   */
+/*                                                                            */
+/*     http://www.apache.org/licenses/LICENSE-2.0                             */
+/*                                                                            */
+/* Unless required by applicable law or agreed to in writing, software        */
+/* distributed under the License is distributed on an "AS IS" BASIS,          */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   */
+/* See the License for the specific language governing permissions and        */
+/* limitations under the License.                                             */
+/*                                                                            */
+/******************************************************************************/
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// FanBeamSART.cpp                                                            //
+// Fan-Beam Iterative Reconstruction Class Source File                        //
+// Created October 15, 2026                                                   //
+//                                                                            //
+// This file contains the source code for OS-SART reconstruction (Andersen    //
+// and Kak, Ultrason. Imaging 6, 1984; ordered subsets after Hudson and       //
+// Larkin). Each ray's pixel weights are its intersection lengths, found with //
+// Siddon's method when needed, so no system matrix is stored. For subset S,  //
+//                                                                            //
+//   x_j += lambda * sum_i(a_ij*(p_i - A_i.x)/A_i.1) / sum_i(a_ij),  i in S   //
+//                                                                            //
+// and the subset's rays are processed in parallel chunks whose numerator and //
+// denominator images are then added in a fixed order.                        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// Class header
+#include "FanBeamSART.hpp"
+
+// C++ headers
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+// C headers
+#include <cmath>
+
+// Custom headers
+#include "Utilities/ParallelFor.hpp"
+
+namespace solutio
+{
+  FanBeamSART::FanBeamSART()
+  {
+    scanner_radius = 0.0;
+    num_channels = 0;
+    channel_width = 0.0;
+    num_rows = 0;
+    row_width = 0.0;
+    num_projections = 0;
+    image_size = 512;
+    pixel_size = 0.1;
+    num_subsets = 1;
+    relaxation = 1.0;
+    num_threads = 1;
+    num_chunks = 8;
+  }
+  
+  void FanBeamSART::SetGeometry(double radius, int n_c, double d_c, int n_r,
+      double d_r)
+  {
+    scanner_radius = radius;
+    num_channels = n_c;
+    channel_width = d_c;
+    num_rows = n_r;
+    row_width = d_r;
+    double fan_angle = (channel_width*num_channels) / scanner_radius;
+    double d_fan_angle = channel_width / scanner_radius;
+    channel_x.resize(num_channels);
+    channel_y.resize(num_channels);
+    for(int c = 0; c < num_channels; c++)
+    {
+      double gamma = M_PI - fan_angle/2.0 + d_fan_angle/2.0 + c*d_fan_angle;
+      channel_x[c] = scanner_radius*(2.0*cos(gamma) + 1.0);
+      channel_y[c] = 2.0*scanner_radius*sin(gamma);
+    }
+  }
+  
+  void FanBeamSART::SetNumProjections(int projs)
+  {
+    num_projections = projs;
+    view_cos.resize(num_projections);
+    view_sin.resize(num_projections);
+    for(int n = 0; n < num_projections; n++)
+    {
+      double a = (2.0*M_PI*n)/num_projections;
+      view_cos[n] = cos(a);
+      view_sin[n] = sin(a);
+    }
+  }
+  
+  void FanBeamSART::SetImage(int size, double pixel)
+  {
+    image_size = size;
+    pixel_size = pixel;
+  }
+  
+  void FanBeamSART::SetNumSubsets(int subsets)
+  {
+    if(subsets < 1)
+    {
+      std::cout << "Error: need at least one subset!\n";
+      return;
+    }
+    num_subsets = subsets;
+  }
+  
+  void FanBeamSART::SetRelaxation(double lambda)
+  {
+    relaxation = lambda;
+  }
+  
+  void FanBeamSART::SetNumThreads(int threads)
+  {
+    num_threads = threads;
+  }
+  
+  void FanBeamSART::SetNumChunks(int chunks)
+  {
+    if(chunks < 1)
+    {
+      std::cout << "Error: need at least one chunk!\n";
+      return;
+    }
+    num_chunks = chunks;
+  }
+  
+  bool FanBeamSART::CheckImage()
+  {
+    if(num_channels < 1 || num_projections < 1 || image_size < 1)
+    {
+      std::cout << "Error: scanner geometry or image not set!\n";
+      return false;
+    }
+    // Every pixel must lie between the source and the detector in all views
+    if(0.5*sqrt(2.0)*image_size*pixel_size >= scanner_radius)
+    {
+      std::cout << "Error: image is larger than the scanner bore!\n";
+      return false;
+    }
+    return true;
+  }
+  
+  void FanBeamSART::GetRay(int view, int channel, double &x_0, double &y_0,
+      double &d_x, double &d_y)
+  {
+    double c = view_cos[view], s = view_sin[view];
+    x_0 = scanner_radius*c;
+    y_0 = scanner_radius*s;
+    d_x = (channel_x[channel]*c - channel_y[channel]*s) - x_0;
+    d_y = (channel_x[channel]*s + channel_y[channel]*c) - y_0;
+  }
+  
+  // Siddon's method in the image plane; pixel (i, j) covers x from
+  // (i - size/2)*pixel to (i + 1 - size/2)*pixel, and likewise in y
+  int FanBeamSART::RayWeights(int view, int channel, std::vector<int> &pixels,
+      std::vector<float> &weights)
+  {
+    double origin[2], direction[2];
+    GetRay(view, channel, origin[0], origin[1], direction[0], direction[1]);
+    double ray_length = sqrt(direction[0]*direction[0] +
+        direction[1]*direction[1]);
+    double low = -0.5*image_size*pixel_size;
+    double high = 0.5*image_size*pixel_size;
+    
+    // Parametric range inside the image
+    double t_in = 0.0, t_out = 1.0;
+    for(int a = 0; a < 2; a++)
+    {
+      if(direction[a] == 0.0)
+      {
+        if(origin[a] < low || origin[a] >= high) return 0;
+        continue;
+      }
+      double t_0 = (low - origin[a])/direction[a];
+      double t_1 = (high - origin[a])/direction[a];
+      t_in = std::max(t_in, std::min(t_0, t_1));
+      t_out = std::min(t_out, std::max(t_0, t_1));
+    }
+    if(t_in >= t_out) return 0;
+    
+    int index[2], step[2];
+    double t_next[2], t_delta[2];
+    for(int a = 0; a < 2; a++)
+    {
+      double p = origin[a] + t_in*direction[a];
+      index[a] = std::min(std::max(int(floor((p - low)/pixel_size)), 0),
+          image_size - 1);
+      if(direction[a] > 0.0)
+      {
+        step[a] = 1;
+        t_next[a] = (low + (index[a] + 1)*pixel_size - origin[a])/direction[a];
+        t_delta[a] = pixel_size/direction[a];
+      }
+      else if(direction[a] < 0.0)
+      {
+        step[a] = -1;
+        t_next[a] = (low + index[a]*pixel_size - origin[a])/direction[a];
+        t_delta[a] = -pixel_size/direction[a];
+      }
+      else
+      {
+        step[a] = 0;
+        t_next[a] = 2.0;
+        t_delta[a] = 0.0;
+      }
+    }
+    
+    // Each ray crosses at most 2*size pixels
+    if(pixels.size() < 2*image_size)
+    {
+      pixels.resize(2*image_size);
+      weights.resize(2*image_size);
+    }
+    int count = 0;
+    double t = t_in;
+    while(true)
+    {
+      int a = (t_next[0] < t_next[1]) ? 0 : 1;
+      double t_exit = std::min(t_next[a], t_out);
+      if(t_exit > t)
+      {
+        pixels[count] = index[1]*image_size + index[0];
+        weights[count] = (t_exit - t)*ray_length;
+        count++;
+      }
+      if(t_next[a] >= t_out) break;
+      t = t_exit;
+      index[a] += step[a];
+      if(index[a] < 0 || index[a] >= image_size) break;
+      t_next[a] += t_delta[a];
+    }
+    return count;
+  }
+  
+  bool FanBeamSART::ForwardProject(const float *image,
+      std::vector<double> &views)
+  {
+    if(!CheckImage()) return false;
+    views.assign(num_projections*num_channels, 0.0);
+    ParallelFor(num_projections, num_threads, [&](int v, int thread_id)
+    {
+      std::vector<int> pixels;
+      std::vector<float> weights;
+      for(int c = 0; c < num_channels; c++)
+      {
+        int count = RayWeights(v, c, pixels, weights);
+        double sum = 0.0;
+        for(int k = 0; k < count; k++) sum += weights[k]*image[(pixels[k])];
+        views[(v*num_channels + c)] = sum;
+      }
+    });
+    return true;
+  }
+  
+  bool FanBeamSART::Backproject(const std::vector<double> &views,
+      float *image)
+  {
+    if(!CheckImage()) return false;
+    if(views.size() != num_projections*num_channels)
+    {
+      std::cout << "Error: views do not match scanner geometry!\n";
+      return false;
+    }
+    // Views are split into fixed chunks and their sums added in order
+    int num_pixels = image_size*image_size;
+    std::vector<double> chunk_images(num_chunks*num_pixels, 0.0);
+    ParallelFor(num_chunks, num_threads, [&](int chunk, int thread_id)
+    {
+      std::vector<int> pixels;
+      std::vector<float> weights;
+      double *sum = &chunk_images[(chunk*num_pixels)];
+      for(int v = chunk; v < num_projections; v += num_chunks)
+      {
+        for(int c = 0; c < num_channels; c++)
+        {
+          int count = RayWeights(v, c, pixels, weights);
+          double value = views[(v*num_channels + c)];
+          for(int k = 0; k < count; k++) sum[(pixels[k])] += weights[k]*value;
+        }
+      }
+    });
+    for(int n = 0; n < num_pixels; n++)
+    {
+      double total = 0.0;
+      for(int chunk = 0; chunk < num_chunks; chunk++)
+      {
+        total += chunk_images[(chunk*num_pixels + n)];
+      }
+      image[n] += total;
+    }
+    return true;
+  }
+  
+  bool FanBeamSART::ReconstructSlice(const std::vector<double> &line_integrals,
+      int row, int iterations, float *image)
+  {
+    if(!CheckImage()) return false;
+    if(line_integrals.size() != num_projections*num_rows*num_channels ||
+        row < 0 || row >= num_rows)
+    {
+      std::cout << "Error: line integrals do not match scanner geometry!\n";
+      return false;
+    }
+    iteration_times.clear();
+    update_times.clear();
+    
+    // Numerator and denominator images of every chunk; the update step
+    // clears them again after reading, so they are only zeroed here
+    int num_pixels = image_size*image_size;
+    std::vector<float> numerator(num_chunks*num_pixels, 0.0f);
+    std::vector<float> denominator(num_chunks*num_pixels, 0.0f);
+    std::vector< std::vector<int> > pixels(num_chunks);
+    std::vector< std::vector<float> > weights(num_chunks);
+    for(int iteration = 0; iteration < iterations; iteration++)
+    {
+      std::chrono::steady_clock::time_point start =
+          std::chrono::steady_clock::now();
+      double update_time = 0.0;
+      for(int subset = 0; subset < num_subsets; subset++)
+      {
+        // Residuals of the subset's rays, normalized by ray length and
+        // backprojected, chunk by chunk
+        ParallelFor(num_chunks, num_threads, [&](int chunk, int thread_id)
+        {
+          float *num = &numerator[(chunk*num_pixels)];
+          float *den = &denominator[(chunk*num_pixels)];
+          std::vector<int> &p = pixels[chunk];
+          std::vector<float> &w = weights[chunk];
+          for(int v = subset + chunk*num_subsets; v < num_projections;
+              v += num_chunks*num_subsets)
+          {
+            const double *measured =
+                &line_integrals[((v*num_rows + row)*num_channels)];
+            for(int c = 0; c < num_channels; c++)
+            {
+              int count = RayWeights(v, c, p, w);
+              double projection = 0.0, length = 0.0;
+              for(int k = 0; k < count; k++)
+              {
+                projection += w[k]*image[(p[k])];
+                length += w[k];
+              }
+              if(length <= 0.0) continue;
+              float residual = (measured[c] - projection)/length;
+              for(int k = 0; k < count; k++)
+              {
+                num[(p[k])] += w[k]*residual;
+                den[(p[k])] += w[k];
+              }
+            }
+          }
+        });
+        
+        // Add the chunks in order and update the image, one image row per
+        // task
+        std::chrono::steady_clock::time_point update_start =
+            std::chrono::steady_clock::now();
+        ParallelFor(image_size, num_threads, [&](int iy, int thread_id)
+        {
+          for(int n = iy*image_size; n < (iy + 1)*image_size; n++)
+          {
+            float num_sum = 0.0f, den_sum = 0.0f;
+            for(int chunk = 0; chunk < num_chunks; chunk++)
+            {
+              num_sum += numerator[(chunk*num_pixels + n)];
+              den_sum += denominator[(chunk*num_pixels + n)];
+              numerator[(chunk*num_pixels + n)] = 0.0f;
+              denominator[(chunk*num_pixels + n)] = 0.0f;
+            }
+            if(den_sum > 0.0f)
+            {
+              image[n] = std::max(0.0f,
+                  float(image[n] + relaxation*num_sum/den_sum));
+            }
+          }
+        });
+        update_time += std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - update_start).count();
+      }
+      iteration_times.push_back(std::chrono::duration<double>(
+          std::chrono::steady_clock::now() - start).count());
+      update_times.push_back(update_time);
+    }
+    return true;
+  }
+}
@@ -0,0 +1,107 @@
+/******************************************************************************/
+/*                                                                            */
+/* Copyright 2016-2017 Steven Dolly                                           */
+/*                                                                            */
+/* Licensed under the Apache License, Version 2.0 (the "License");            */
+/* you may not use this file except in compliance with the License.           */
+/* You may obtain a copy of the License at:                                   */
+/*                                                                            */
+/*     http://www.apache.org/licenses/LICENSE-2.0                             */
+/*                                                                            */
+/* Unless required by applicable law or agreed to in writing, software        */
+/* distributed under the License is distributed on an "AS IS" BASIS,          */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   */
+/* See the License for the specific language governing permissions and        */
+/* limitations under the License.                                             */
+/*                                                                            */
+/******************************************************************************/
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// FanBeamSART.hpp                                                            //
+// Fan-Beam Iterative Reconstruction Class Header File                        //
+// Created October 15, 2026                                                   //
+//                                                                            //
+// This header file contains the class for ordered-subset simultaneous        //
+// algebraic reconstruction (OS-SART) of axial CT data acquired with RayCT,   //
+// using the same equiangular fan-beam geometry and data layout as            //
+// FanBeamFBP. The forward projector and backprojector are an exactly         //
+// matched (transposed) pair, with ray weights computed on the fly.           //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// Header guard
+#ifndef FANBEAMSART_HPP
+#define FANBEAMSART_HPP
+
+// Standard C++ header files
+#include <vector>
+
+namespace solutio
+{
+  class FanBeamSART
+  {
+    public:
+      FanBeamSART();
+      // Scanner geometry, with the same parameters as RayCT::SetGeometry
+      void SetGeometry(double radius, int n_c, double d_c, int n_r, double d_r);
+      void SetNumProjections(int projs);
+      // Square image of size x size pixels, centered on the isocenter
+      void SetImage(int size, double pixel);
+      // Number of ordered subsets (subset s holds views s, s + M, s + 2M, ...)
+      // and the relaxation factor of each update
+      void SetNumSubsets(int subsets);
+      void SetRelaxation(double lambda);
+      // Parallel settings (0 threads = all hardware threads); the rays of a
+      // subset are split into a fixed number of chunks, each with its own
+      // accumulation images, so results do not depend on the thread count
+      void SetNumThreads(int threads);
+      void SetNumChunks(int chunks);
+      // Forward projection of an image (line integrals, views x channels)
+      bool ForwardProject(const float *image, std::vector<double> &views);
+      // Transpose of ForwardProject, added into a preallocated image
+      bool Backproject(const std::vector<double> &views, float *image);
+      // Run OS-SART iterations on one detector row of line integrals (views x
+      // rows x channels), starting from the current image (e.g. zeros or an
+      // FBP slice); the image is kept non-negative
+      bool ReconstructSlice(const std::vector<double> &line_integrals, int row,
+          int iterations, float *image);
+      // Wall time of each iteration of the last reconstruction, and the part
+      // of it spent combining chunks and updating the image (in seconds)
+      const std::vector<double> &GetIterationTimes(){ return iteration_times; }
+      const std::vector<double> &GetUpdateTimes(){ return update_times; }
+    private:
+      bool CheckImage();
+      // Source position and source-to-detector vector of a ray, in image
+      // coordinates
+      void GetRay(int view, int channel, double &x_0, double &y_0,
+          double &d_x, double &d_y);
+      // Pixels and intersection lengths of a ray; returns the number found
+      int RayWeights(int view, int channel, std::vector<int> &pixels,
+          std::vector<float> &weights);
+      // Scanner geometry parameters
+      double scanner_radius;
+      int num_channels;
+      double channel_width;
+      int num_rows;
+      double row_width;
+      int num_projections;
+      // Detector element positions before the view rotation, and the view
+      // rotations (as in RayCT)
+      std::vector<double> channel_x, channel_y;
+      std::vector<double> view_cos, view_sin;
+      // Image parameters
+      int image_size;
+      double pixel_size;
+      // Iteration parameters
+      int num_subsets;
+      double relaxation;
+      int num_threads;
+      int num_chunks;
+      std::vector<double> iteration_times;
+      std::vector<double> update_times;
+  };
+}
+
+// End header guard
+#endif
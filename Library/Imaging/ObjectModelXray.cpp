@@ -33,13 +33,31 @@
 #include "ObjectModelXray.hpp"
 
 // C++ headers
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 
 namespace solutio
 {
+  ObjectModelXray::ObjectModelXray()
+  {
+    transmission_length = 0.0;
+    transmission_error = 0.0;
+    spectrum_error = 0.0;
+    single_precision = false;
+  }
+
   void ObjectModelXray::AddMaterial(std::string folder, std::string name)
   {
     NistPad NewMat(folder, name);
+    if(!NewMat.IsLoaded())
+    {
+      std::cout << "Error: material \"" << name << "\" not added!\n";
+      return;
+    }
+    NewMat.TabulateEnergyGrid(0.0, 0.150, 151);
     MuData.push_back(NewMat);
   }
 
@@ -47,6 +65,12 @@ namespace solutio
       std::string new_name)
   {
     NistPad NewMat(folder, name);
+    if(!NewMat.IsLoaded())
+    {
+      std::cout << "Error: material \"" << name << "\" not added!\n";
+      return;
+    }
+    NewMat.TabulateEnergyGrid(0.0, 0.150, 151);
     NewMat.Rename(new_name);
     MuData.push_back(NewMat);
   }
@@ -55,25 +79,35 @@ namespace solutio
       std::string new_name, float new_density)
   {
     NistPad NewMat(folder, name);
+    if(!NewMat.IsLoaded())
+    {
+      std::cout << "Error: material \"" << name << "\" not added!\n";
+      return;
+    }
+    NewMat.TabulateEnergyGrid(0.0, 0.150, 151);
     NewMat.Rename(new_name);
     NewMat.ForceDensity(new_density);
     MuData.push_back(NewMat);
   }
   
-  void ObjectModelXray::AssignMaterial(std::string material)
+  int ObjectModelXray::FindMaterial(std::string material)
   {
-    bool found = false;
     for(int n = 0; n < MuData.size(); n++)
     {
-      if(material == MuData[n].get_name())
-      {
-        object_material_name.push_back(MuData[n].get_name());
-        object_material_id.push_back(n);
-        found = true;
-        break;
-      }
+      if(material == MuData[n].get_name()) return n;
+    }
+    return -1;
+  }
+  
+  void ObjectModelXray::AssignMaterial(std::string material)
+  {
+    int n = FindMaterial(material);
+    if(n >= 0)
+    {
+      object_material_name.push_back(MuData[n].get_name());
+      object_material_id.push_back(n);
     }
-    if(!found) std::cout << "Error: could not find element/material!\n";
+    else std::cout << "Error: could not find element/material!\n";
   }
   
   void ObjectModelXray::AddObject(std::string name, GeometricObject &G,
@@ -107,66 +141,883 @@ namespace solutio
       }
       tabulated_mu_lists.push_back(current_list);
     }
+    tabulated_spectrum = spectrum;
+    
+    // Single precision copies, without the empty bins
+    float_spectrum.clear();
+    float_mu_lists.clear();
+    for(int e = 0; e < spectrum.size(); e++)
+    {
+      if(spectrum[e] != 0.0) float_spectrum.push_back(spectrum[e]);
+    }
+    for(int n = 0; n < tabulated_mu_lists.size(); n++)
+    {
+      for(int e = 0; e < spectrum.size(); e++)
+      {
+        if(spectrum[e] != 0.0)
+        {
+          float_mu_lists.push_back(tabulated_mu_lists[n][e]);
+        }
+      }
+    }
   }
-  
+
+  // Path length at node n of a transmission grid; nodes are packed towards
+  // zero length, where beam hardening bends the log transmission the most
+  static inline double TransmissionNode(const TransmissionTable &table,
+      double n)
+  {
+    double u = n/(table.num_points - 1);
+    return (table.max_length*u*u);
+  }
+
+  // exp(-mu(E)*L) for each nonzero spectrum bin and each length (stored
+  // length by length)
+  void ObjectModelXray::TransmissionFactors(int material,
+      const std::vector<double> &lengths, std::vector<double> &factors)
+  {
+    int num_bins = spectrum_bins.size();
+    factors.resize(lengths.size()*num_bins);
+    for(int n = 0; n < lengths.size(); n++)
+    {
+      for(int k = 0; k < num_bins; k++)
+      {
+        factors[(n*num_bins + k)] = exp(-tabulated_mu_lists[material][
+            (spectrum_bins[k])]*lengths[n]);
+      }
+    }
+  }
+
+  bool ObjectModelXray::TabulateTransmission(double max_length,
+      double tolerance)
+  {
+    if(!IsListTabulated())
+    {
+      std::cout << "Error: attenuation lists must be tabulated first!\n";
+      return false;
+    }
+    // Transmission through two materials is separable in the path lengths,
+    // T(a,b) = sum_E S(E)*exp(-mu_1(E)*a)*exp(-mu_2(E)*b), so each grid only
+    // needs the exponentials along its axes. The log of T is interpolated
+    // linearly in the path lengths, which is exact for a single energy, and
+    // the error is checked at the cell centers.
+    const double min_log = -700.0;
+    const int max_points_1d = 4097, max_points_2d = 1025;
+    int num_materials = tabulated_mu_lists.size();
+    transmission_1d.clear();
+    transmission_2d.clear();
+    spectrum_bins.clear();
+    std::vector<double> weights;
+    for(int e = 0; e < tabulated_spectrum.size(); e++)
+    {
+      if(tabulated_spectrum[e] == 0.0) continue;
+      spectrum_bins.push_back(e);
+      weights.push_back(tabulated_spectrum[e]);
+    }
+    int num_bins = spectrum_bins.size();
+    if(num_bins == 0)
+    {
+      std::cout << "Error: spectrum is empty!\n";
+      return false;
+    }
+    transmission_1d.assign(num_materials, TransmissionTable());
+    transmission_2d.assign(num_materials*num_materials, TransmissionTable());
+    transmission_length = max_length;
+    transmission_error = 0.0;
+    
+    std::vector<double> nodes, centers, f_a, f_b, g_a, g_b;
+    for(int a = 0; a < num_materials; a++)
+    {
+      for(int b = a; b < num_materials; b++)
+      {
+        // b == a stands for the single-material table
+        bool single = (b == a);
+        TransmissionTable &table = single ? transmission_1d[a] :
+            transmission_2d[(a*num_materials + b)];
+        int max_points = single ? max_points_1d : max_points_2d;
+        double error = 0.0;
+        for(int n = 17; n <= max_points; n = 2*n - 1)
+        {
+          table.num_points = n;
+          table.max_length = max_length;
+          nodes.resize(n);
+          centers.resize(n - 1);
+          for(int i = 0; i < n; i++) nodes[i] = TransmissionNode(table, i);
+          for(int i = 0; i < n - 1; i++)
+          {
+            centers[i] = 0.5*(nodes[i] + nodes[(i + 1)]);
+          }
+          int num_b = single ? 1 : n;
+          int num_cells_b = single ? 1 : (n - 1);
+          TransmissionFactors(a, nodes, f_a);
+          TransmissionFactors(a, centers, g_a);
+          if(single)
+          {
+            f_b.assign(num_bins, 1.0);
+            g_b.assign(num_bins, 1.0);
+          }
+          else
+          {
+            TransmissionFactors(b, nodes, f_b);
+            TransmissionFactors(b, centers, g_b);
+          }
+          table.log_transmission.resize(n*num_b);
+          for(int i = 0; i < n; i++)
+          {
+            for(int j = 0; j < num_b; j++)
+            {
+              double t = 0.0;
+              for(int k = 0; k < num_bins; k++)
+              {
+                t += weights[k]*f_a[(i*num_bins + k)]*f_b[(j*num_bins + k)];
+              }
+              table.log_transmission[(i*num_b + j)] =
+                  std::max(log(t), min_log);
+            }
+          }
+          // Compare with the exact sum at the cell centers
+          error = 0.0;
+          for(int i = 0; i < n - 1; i++)
+          {
+            for(int j = 0; j < num_cells_b; j++)
+            {
+              double exact = 0.0;
+              for(int k = 0; k < num_bins; k++)
+              {
+                exact += weights[k]*g_a[(i*num_bins + k)]*g_b[(j*num_bins + k)];
+              }
+              if(!(log(exact) > min_log)) continue;
+              const double *l = &table.log_transmission[(i*num_b + j)];
+              double log_t = single ? 0.5*(l[0] + l[1]) :
+                  0.25*(l[0] + l[1] + l[num_b] + l[(num_b + 1)]);
+              error = std::max(error, fabs(exp(log_t)/exact - 1.0));
+            }
+          }
+          if(error <= tolerance) break;
+        }
+        transmission_error = std::max(transmission_error, error);
+      }
+    }
+    // Tables outside the tolerance are not kept, so rays use the full
+    // spectrum sums instead
+    if(transmission_error > tolerance)
+    {
+      std::cout << "Warning: transmission tables only reach a relative " <<
+          "error of " << transmission_error << ", not used!\n";
+      transmission_1d.clear();
+      transmission_2d.clear();
+      return false;
+    }
+    return true;
+  }
+
+  // Least squares solution of A*x = 1, for A stored column by column, by
+  // modified Gram-Schmidt (the columns of nearby energies are close to
+  // collinear, so the normal equations would lose too much precision).
+  // Returns the residual sum of squares, or -1 if the columns are dependent.
+  static double OnesLeastSquares(std::vector<double> A, int rows, int cols,
+      std::vector<double> &x)
+  {
+    std::vector<double> R(cols*cols, 0.0), b(rows, 1.0), c(cols);
+    for(int j = 0; j < cols; j++)
+    {
+      double *v = &A[(j*rows)];
+      for(int i = 0; i < j; i++)
+      {
+        const double *q = &A[(i*rows)];
+        double dot = 0.0;
+        for(int n = 0; n < rows; n++) dot += q[n]*v[n];
+        for(int n = 0; n < rows; n++) v[n] -= dot*q[n];
+        R[(i*cols + j)] = dot;
+      }
+      double norm = 0.0;
+      for(int n = 0; n < rows; n++) norm += v[n]*v[n];
+      norm = sqrt(norm);
+      if(!(norm > 1.0e-12)) return -1.0;
+      for(int n = 0; n < rows; n++) v[n] /= norm;
+      R[(j*cols + j)] = norm;
+      double dot = 0.0;
+      for(int n = 0; n < rows; n++) dot += v[n]*b[n];
+      for(int n = 0; n < rows; n++) b[n] -= dot*v[n];
+      c[j] = dot;
+    }
+    x.resize(cols);
+    for(int j = cols - 1; j >= 0; j--)
+    {
+      double sum = c[j];
+      for(int i = j + 1; i < cols; i++) sum -= R[(j*cols + i)]*x[i];
+      x[j] = sum/R[(j*cols + j)];
+    }
+    double residual = 0.0;
+    for(int n = 0; n < rows; n++) residual += b[n]*b[n];
+    return residual;
+  }
+
+  bool ObjectModelXray::CompressSpectrum(const std::vector<double> &spectrum,
+      double max_length, double tolerance, std::vector<double> &compressed,
+      int max_nodes)
+  {
+    // Nonzero bins and normalized weights of the full spectrum
+    std::vector<int> bins;
+    std::vector<double> weights;
+    double total = 0.0;
+    for(int e = 0; e < spectrum.size(); e++)
+    {
+      if(spectrum[e] == 0.0) continue;
+      bins.push_back(e);
+      weights.push_back(spectrum[e]);
+      total += spectrum[e];
+    }
+    int num_bins = bins.size();
+    int num_materials = MuData.size();
+    if(num_bins == 0 || num_materials == 0 || !(total > 0.0))
+    {
+      std::cout << "Error: spectrum or materials are empty!\n";
+      return false;
+    }
+    for(int k = 0; k < num_bins; k++) weights[k] /= total;
+    std::vector<double> mu(num_materials*num_bins);
+    for(int m = 0; m < num_materials; m++)
+    {
+      for(int k = 0; k < num_bins; k++)
+      {
+        mu[(m*num_bins + k)] = MuData[m].GridLinearAttenuation(bins[k]);
+      }
+    }
+    
+    // Training paths: lengths (packed towards zero, as for the transmission
+    // tables) through single materials and pairs of materials, with the full
+    // spectrum transmission of each; only paths the detector still sees are
+    // kept. The exponentials of each bin are stored divided by the
+    // transmission, so fitting A*w = 1 minimizes the relative error.
+    const int num_lengths = 16;
+    const double min_transmission = 1.0e-6;
+    std::vector<double> A, exponent(num_bins);
+    int num_paths = 0;
+    auto add_path = [&](int a, double L_a, int b, double L_b)
+    {
+      double T = 0.0;
+      for(int k = 0; k < num_bins; k++)
+      {
+        exponent[k] = exp(-mu[(a*num_bins + k)]*L_a - mu[(b*num_bins + k)]*L_b);
+        T += weights[k]*exponent[k];
+      }
+      if(T < min_transmission) return;
+      for(int k = 0; k < num_bins; k++) A.push_back(exponent[k]/T);
+      num_paths++;
+    };
+    std::vector<double> lengths(num_lengths);
+    for(int i = 0; i < num_lengths; i++)
+    {
+      double u = double(i)/(num_lengths - 1);
+      lengths[i] = max_length*u*u;
+    }
+    add_path(0, 0.0, 0, 0.0);
+    for(int a = 0; a < num_materials; a++)
+    {
+      for(int i = 1; i < num_lengths; i++) add_path(a, lengths[i], a, 0.0);
+      for(int b = a + 1; b < num_materials; b++)
+      {
+        for(int i = 1; i < num_lengths; i++)
+        {
+          for(int j = 1; j < num_lengths; j++)
+          {
+            add_path(a, lengths[i], b, lengths[j]);
+          }
+        }
+      }
+    }
+    // Stored path by path; transpose to one column per bin
+    std::vector<double> columns(num_bins*num_paths);
+    for(int n = 0; n < num_paths; n++)
+    {
+      for(int k = 0; k < num_bins; k++)
+      {
+        columns[(k*num_paths + n)] = A[(n*num_bins + k)];
+      }
+    }
+    
+    std::vector<double> column_norms(num_bins, 0.0);
+    for(int k = 0; k < num_bins; k++)
+    {
+      for(int p = 0; p < num_paths; p++)
+      {
+        column_norms[k] += columns[(k*num_paths + p)]*
+            columns[(k*num_paths + p)];
+      }
+      column_norms[k] = sqrt(column_norms[k]);
+    }
+    
+    // Nonnegative least squares by the active set method of Lawson and
+    // Hanson, stopped once the nodes reach the tolerance: each step adds the
+    // bin best correlated with the residual, then moves towards the least
+    // squares weights of the nodes, dropping any node whose weight would
+    // turn negative (dropped bins are not tried again)
+    std::vector<int> nodes;
+    std::vector<double> node_weights, solution, trial, residual(num_paths);
+    std::vector<bool> used(num_bins, false);
+    spectrum_error = 1.0;
+    while(nodes.size() < max_nodes)
+    {
+      for(int p = 0; p < num_paths; p++)
+      {
+        residual[p] = 1.0;
+        for(int n = 0; n < nodes.size(); n++)
+        {
+          residual[p] -= node_weights[n]*columns[(nodes[n]*num_paths + p)];
+        }
+      }
+      int best = -1;
+      double best_gradient = 0.0;
+      for(int k = 0; k < num_bins; k++)
+      {
+        if(used[k]) continue;
+        double gradient = 0.0;
+        for(int p = 0; p < num_paths; p++)
+        {
+          gradient += columns[(k*num_paths + p)]*residual[p];
+        }
+        gradient /= column_norms[k];
+        if(gradient > best_gradient)
+        {
+          best = k;
+          best_gradient = gradient;
+        }
+      }
+      if(best < 0) break;
+      nodes.push_back(best);
+      node_weights.push_back(0.0);
+      used[best] = true;
+      while(true)
+      {
+        int cols = nodes.size();
+        trial.resize(cols*num_paths);
+        for(int n = 0; n < cols; n++)
+        {
+          std::copy(&columns[(nodes[n]*num_paths)],
+              &columns[(nodes[n]*num_paths)] + num_paths,
+              &trial[(n*num_paths)]);
+        }
+        if(OnesLeastSquares(trial, num_paths, cols, solution) < 0.0)
+        {
+          // Dependent on the other nodes; leave it out
+          nodes.pop_back();
+          node_weights.pop_back();
+          break;
+        }
+        double alpha = 1.0;
+        for(int n = 0; n < cols; n++)
+        {
+          if(solution[n] <= 0.0)
+          {
+            alpha = std::min(alpha, node_weights[n]/(node_weights[n] -
+                solution[n]));
+          }
+        }
+        for(int n = 0; n < cols; n++)
+        {
+          node_weights[n] += alpha*(solution[n] - node_weights[n]);
+        }
+        if(alpha == 1.0) break;
+        for(int n = cols - 1; n >= 0; n--)
+        {
+          if(node_weights[n] > 1.0e-12) continue;
+          nodes.erase(nodes.begin() + n);
+          node_weights.erase(node_weights.begin() + n);
+        }
+      }
+      
+      // Rescale so an unattenuated ray is exact, then check every path
+      double sum = 0.0;
+      for(int n = 0; n < nodes.size(); n++) sum += node_weights[n];
+      spectrum_error = 0.0;
+      for(int p = 0; p < num_paths; p++)
+      {
+        double ratio = 0.0;
+        for(int n = 0; n < nodes.size(); n++)
+        {
+          ratio += node_weights[n]*columns[(nodes[n]*num_paths + p)];
+        }
+        spectrum_error = std::max(spectrum_error, fabs(ratio/sum - 1.0));
+      }
+      if(spectrum_error <= tolerance) break;
+    }
+    double sum = 0.0;
+    for(int n = 0; n < nodes.size(); n++) sum += node_weights[n];
+    
+    compressed.assign(spectrum.size(), 0.0);
+    for(int n = 0; n < nodes.size(); n++)
+    {
+      compressed[(bins[(nodes[n])])] = total*node_weights[n]/sum;
+    }
+    if(spectrum_error > tolerance)
+    {
+      std::cout << "Warning: compressed spectrum (" << nodes.size() <<
+          " nodes) only reaches a relative error of " << spectrum_error <<
+          "!\n";
+      return false;
+    }
+    return true;
+  }
+
+  // Transmission from the lookup tables, if the ray only crosses one or two
+  // materials within the tabulated lengths
+  bool ObjectModelXray::TableTransmission(
+      const std::vector<double> &pathlengths,
+      const std::vector<int> &ray_materials, double &transmission)
+  {
+    // Total path length per material
+    int material[2] = {-1, -1};
+    double length[2] = {0.0, 0.0};
+    int num_used = 0;
+    for(int n = 0; n < pathlengths.size(); n++)
+    {
+      if(pathlengths[n] == 0.0) continue;
+      int m = 0;
+      while(m < num_used && material[m] != ray_materials[n]) m++;
+      if(m == num_used)
+      {
+        if(num_used == 2) return false;
+        material[m] = ray_materials[n];
+        num_used++;
+      }
+      length[m] += pathlengths[n];
+    }
+    if(num_used == 0)
+    {
+      transmission = exp(transmission_1d[0].log_transmission[0]);
+      return true;
+    }
+    if(num_used == 2 && material[0] > material[1])
+    {
+      std::swap(material[0], material[1]);
+      std::swap(length[0], length[1]);
+    }
+    const TransmissionTable &table = (num_used == 1) ?
+        transmission_1d[(material[0])] :
+        transmission_2d[(material[0]*transmission_1d.size() + material[1])];
+    // Cell index from the inverse of the node spacing, then the fraction
+    // across the cell in path length
+    int index[2] = {0, 0};
+    double frac[2] = {0.0, 0.0};
+    for(int m = 0; m < num_used; m++)
+    {
+      if(!(length[m] >= 0.0) || length[m] > transmission_length) return false;
+      double u = sqrt(length[m]/table.max_length)*(table.num_points - 1);
+      index[m] = std::min(int(u), table.num_points - 2);
+      double l_0 = TransmissionNode(table, index[m]);
+      double l_1 = TransmissionNode(table, index[m] + 1);
+      frac[m] = (length[m] - l_0)/(l_1 - l_0);
+    }
+    const double *l;
+    if(num_used == 1)
+    {
+      l = &table.log_transmission[(index[0])];
+      transmission = exp(l[0] + frac[0]*(l[1] - l[0]));
+    }
+    else
+    {
+      int n = table.num_points;
+      l = &table.log_transmission[(index[0]*n + index[1])];
+      double low = l[0] + frac[1]*(l[1] - l[0]);
+      double high = l[n] + frac[1]*(l[(n + 1)] - l[n]);
+      transmission = exp(low + frac[0]*(high - low));
+    }
+    return true;
+  }
+
   bool ObjectModelXray::IsListTabulated()
   {
     return (tabulated_mu_lists.size() != 0);
   }
 
+  const std::vector<double> &ObjectModelXray::MatchTabulatedSpectrum(
+      const std::vector<double> &spectrum)
+  {
+    if(IsListTabulated() && (&spectrum == &tabulated_spectrum ||
+        spectrum == tabulated_spectrum))
+    {
+      return tabulated_spectrum;
+    }
+    return spectrum;
+  }
+
   double ObjectModelXray::GetRayAttenuation(Ray3 ray,
-      std::vector<double> spectrum)
+      const std::vector<double> &spectrum)
+  {
+    static thread_local XrayRayScratch scratch;
+    return GetRayAttenuation(ray, spectrum, scratch);
+  }
+
+  double ObjectModelXray::GetRayAttenuation(Ray3 ray,
+      const std::vector<double> &spectrum, XrayRayScratch &scratch)
   {
     int parent_id;
     double length;
-    std::vector<double> pathlengths;
-    std::vector<int> ray_object_ids;
-    std::vector<int> ray_materials;
-    std::vector<bool> ray_intersect(object_parent.size());
+    std::vector<double> &pathlengths = scratch.pathlengths;
+    std::vector<int> &ray_object_ids = scratch.ray_object_ids;
+    std::vector<int> &ray_materials = scratch.ray_materials;
+    std::vector<char> &ray_intersect = scratch.ray_intersect;
+    pathlengths.clear();
+    ray_object_ids.clear();
+    ray_materials.clear();
+    const std::vector<double> &source = MatchTabulatedSpectrum(spectrum);
+    // Flags are all false between calls, only the ones set are reset below;
+    // the lists can never hold more than one entry per object
+    if(ray_intersect.size() < object_parent.size())
+    {
+      ray_intersect.resize(object_parent.size(), false);
+      pathlengths.reserve(object_parent.size());
+      ray_object_ids.reserve(object_parent.size());
+      ray_materials.reserve(object_parent.size());
+      scratch.candidates.reserve(object_parent.size());
+    }
   
     // Start at outermost level (the "world")
     pathlengths.push_back(ray.direction.Magnitude());
     ray_object_ids.push_back(world_id);
     ray_materials.push_back(object_material_id[world_id]);
-    ray_intersect[0] = true;
+    ray_intersect[world_id] = true;
   
-    // Loop for each subsequent level
-   
-    for(int m = 1; m < object_levels.size(); m++)
+    // Loop over the objects the ray might hit, level by level
+    std::vector<int> &candidates = scratch.candidates;
+    FindCandidates(ray, candidates);
+    for(int k = 0; k < candidates.size(); k++)
     {
-      for(int n = 0; n < object_levels[m].size(); n++)
+      int id = candidates[k];
+      if(!ray_intersect[(object_parent[id])]) continue;
+      // Check if ray intersects with any children
+      length = object_pointers[id]->RayPathlength(ray);
+      
+      // Save material IDs and path lengths for children, subtract pathlengths
+      // from parents
+      if(length > 1.0e-6)
       {
-        if(!ray_intersect[(object_parent[(object_levels[m][n])])]) continue;
-        // Check if ray intersects with any children
-        length = object_pointers[(object_levels[m][n])]->RayPathlength(ray);
+        pathlengths.push_back(length);
+        ray_object_ids.push_back(id);
+        ray_materials.push_back(object_material_id[id]);
+        ray_intersect[id] = true;
+        
+        parent_id = 0;
+        while(object_parent[id] != ray_object_ids[parent_id]) parent_id++;
+        pathlengths[parent_id] -= length;
         
-        // Save material IDs and path lengths for children, subtract pathlengths
-        // from parents
-        if(length > 1.0e-6)
-        {
-          pathlengths.push_back(length);
-          ray_object_ids.push_back((object_levels[m][n]));
-          ray_materials.push_back(object_material_id[(object_levels[m][n])]);
-          ray_intersect[(object_levels[m][n])] = true;
-          
-          parent_id = 0;
-          while(object_parent[(object_levels[m][n])] !=
-              ray_object_ids[parent_id]) parent_id++;
-          pathlengths[parent_id] -= length;
-          
-        }
-        else { ray_intersect[(object_levels[m][n])] = false; }
-      }
-    }
-    // Sum up path lengths and attenuation coefficients
-    double total_sum = 0.0, energy, mu;
+      }
+    }
+    for(int n = 0; n < ray_object_ids.size(); n++)
+    {
+      ray_intersect[(ray_object_ids[n])] = false;
+    }
+    return SpectrumAttenuation(pathlengths, ray_materials, source, scratch);
+  }
+
+  void ObjectModelXray::GetRayAttenuations(const RayBatch &rays,
+      const std::vector<double> &spectrum, double *attenuations,
+      const double *air_attenuations)
+  {
+    static thread_local XrayRayScratch scratch;
+    GetRayAttenuations(rays, spectrum, attenuations, scratch,
+        air_attenuations);
+  }
+
+  void ObjectModelXray::GetRayAttenuations(const RayBatch &rays,
+      const std::vector<double> &spectrum, double *attenuations,
+      XrayRayScratch &scratch, const double *air_attenuations)
+  {
+    const std::vector<double> &source = MatchTabulatedSpectrum(spectrum);
+    IntersectBatch(rays, scratch);
+    for(int r = 0; r < rays.Size(); r++)
+    {
+      BatchRayLists(rays, r, scratch);
+      // Only the world entry: the ray misses every object
+      if(air_attenuations != nullptr && scratch.pathlengths.size() == 1)
+      {
+        attenuations[r] = air_attenuations[r];
+        continue;
+      }
+      attenuations[r] = SpectrumAttenuation(scratch.pathlengths,
+          scratch.ray_materials, source, scratch);
+    }
+  }
+  
+  int ObjectModelXray::WorldMaterial()
+  {
+    if(world_id >= object_material_id.size()) return -1;
+    return object_material_id[world_id];
+  }
+  
+  // Z/A of liquid water (NIST), with density 1 g/cm^3
+  const double kWaterZtoA = 0.55508;
+  
+  double ObjectModelXray::GetRelativeElectronDensity(int material)
+  {
+    if(material < 0 || material >= MuData.size()) return 0.0;
+    return (MuData[material].GetDensity()*MuData[material].GetZtoA() /
+        kWaterZtoA);
+  }
+  
+  double ObjectModelXray::WorldAttenuation(double length,
+      const std::vector<double> &spectrum)
+  {
+    static thread_local XrayRayScratch scratch;
+    scratch.pathlengths.clear();
+    scratch.ray_materials.clear();
+    int material = WorldMaterial();
+    if(material >= 0)
+    {
+      scratch.pathlengths.push_back(length);
+      scratch.ray_materials.push_back(material);
+    }
+    return SpectrumAttenuation(scratch.pathlengths, scratch.ray_materials,
+        MatchTabulatedSpectrum(spectrum), scratch);
+  }
+  
+  void ObjectModelXray::IntersectBatch(const RayBatch &rays,
+      XrayRayScratch &scratch)
+  {
+    int num_rays = rays.Size();
+    
+    // Intersect the whole batch with each object any of its rays might hit,
+    // storing the path lengths candidate by candidate
+    std::vector<int> &candidates = scratch.candidates;
+    FindCandidates(rays, candidates);
+    int num_candidates = candidates.size();
+    std::vector<double> &lengths = scratch.lengths;
+    lengths.resize(num_candidates*num_rays);
+    for(int k = 0; k < num_candidates; k++)
+    {
+      object_pointers[(candidates[k])]->RayPathlengths(rays,
+          &lengths[(k*num_rays)]);
+    }
+    // Position of each candidate's parent in the candidate list (-1 for the
+    // world, -2 if the parent is not a candidate so no ray can reach it)
+    std::vector<int> &parent_slot = scratch.parent_slot;
+    parent_slot.resize(num_candidates);
+    for(int k = 0; k < num_candidates; k++)
+    {
+      int parent = object_parent[(candidates[k])];
+      if(parent == world_id)
+      {
+        parent_slot[k] = -1;
+        continue;
+      }
+      int rank = object_rank[parent];
+      std::vector<int>::iterator it = std::lower_bound(candidates.begin(),
+          candidates.begin() + k, rank, [this](int id, int r)
+      {
+        return (object_rank[id] < r);
+      });
+      parent_slot[k] = (it != candidates.begin() + k && *it == parent) ?
+          (it - candidates.begin()) : -2;
+    }
+    scratch.entry.resize(num_candidates);
+  }
+  
+  // Build the per-ray lists in the same order as GetRayAttenuation, so both
+  // give identical results; entry holds each candidate's position in the list
+  // (-1 if the ray misses it)
+  void ObjectModelXray::BatchRayLists(const RayBatch &rays, int r,
+      XrayRayScratch &scratch)
+  {
+    int num_rays = rays.Size();
+    int num_candidates = scratch.candidates.size();
+    const std::vector<int> &candidates = scratch.candidates;
+    const std::vector<double> &lengths = scratch.lengths;
+    const std::vector<int> &parent_slot = scratch.parent_slot;
+    std::vector<double> &pathlengths = scratch.pathlengths;
+    std::vector<int> &ray_materials = scratch.ray_materials;
+    std::vector<int> &entry = scratch.entry;
+    pathlengths.clear();
+    ray_materials.clear();
+    pathlengths.push_back(sqrt(rays.direction_x[r]*rays.direction_x[r] +
+        rays.direction_y[r]*rays.direction_y[r] +
+        rays.direction_z[r]*rays.direction_z[r]));
+    ray_materials.push_back(object_material_id[world_id]);
+    for(int k = 0; k < num_candidates; k++)
+    {
+      int slot = parent_slot[k];
+      int parent_entry = (slot == -1) ? 0 : ((slot < 0) ? -1 : entry[slot]);
+      double length = lengths[(k*num_rays + r)];
+      entry[k] = -1;
+      if(parent_entry < 0 || !(length > 1.0e-6)) continue;
+      entry[k] = pathlengths.size();
+      pathlengths.push_back(length);
+      ray_materials.push_back(object_material_id[(candidates[k])]);
+      pathlengths[parent_entry] -= length;
+    }
+  }
+  
+  void ObjectModelXray::TraceRays(const RayBatch &rays, RayPathCache &cache)
+  {
+    static thread_local XrayRayScratch scratch;
+    TraceRays(rays, cache, scratch);
+  }
+  
+  void ObjectModelXray::TraceRays(const RayBatch &rays, RayPathCache &cache,
+      XrayRayScratch &scratch)
+  {
+    IntersectBatch(rays, scratch);
+    for(int r = 0; r < rays.Size(); r++)
+    {
+      BatchRayLists(rays, r, scratch);
+      cache.AddRay(scratch.pathlengths, scratch.ray_materials);
+    }
+  }
+  
+  void ObjectModelXray::ApplySpectrum(const RayPathCache &cache,
+      const std::vector<double> &spectrum, double *attenuations)
+  {
+    // The tabulated spectrum keeps its transmission tables and single
+    // precision path
+    const std::vector<double> &source = MatchTabulatedSpectrum(spectrum);
+    if(&source == &tabulated_spectrum)
+    {
+      static thread_local XrayRayScratch scratch;
+      for(int r = 0; r < cache.Size(); r++)
+      {
+        int begin = cache.ray_begin[r], end = cache.ray_begin[(r + 1)];
+        scratch.pathlengths.assign(cache.lengths.begin() + begin,
+            cache.lengths.begin() + end);
+        scratch.ray_materials.assign(cache.materials.begin() + begin,
+            cache.materials.begin() + end);
+        attenuations[r] = SpectrumAttenuation(scratch.pathlengths,
+            scratch.ray_materials, source, scratch);
+      }
+      return;
+    }
+    // Otherwise use the materials' own energy grids (1 keV bins)
+    std::vector< std::vector<double> > mu_lists(MuData.size(),
+        std::vector<double>(spectrum.size(), 0.0));
+    for(int m = 0; m < MuData.size(); m++)
+    {
+      for(int e = 0; e < spectrum.size(); e++)
+      {
+        if(spectrum[e] != 0.0)
+        {
+          mu_lists[m][e] = MuData[m].GridLinearAttenuation(e);
+        }
+      }
+    }
+    ApplySpectrum(cache, spectrum, mu_lists, attenuations);
+  }
+  
+  bool ObjectModelXray::ApplySpectrum(const RayPathCache &cache,
+      const std::vector<double> &spectrum,
+      const std::vector< std::vector<double> > &mu_lists, double *attenuations)
+  {
+    // Compact the lists to the bins with nonzero weight
+    std::vector<double> weights;
+    std::vector<int> bins;
+    for(int e = 0; e < spectrum.size(); e++)
+    {
+      if(spectrum[e] == 0.0) continue;
+      weights.push_back(spectrum[e]);
+      bins.push_back(e);
+    }
+    int num_bins = bins.size();
+    std::vector<double> mu(mu_lists.size()*num_bins);
+    for(int m = 0; m < mu_lists.size(); m++)
+    {
+      if(mu_lists[m].size() < spectrum.size())
+      {
+        std::cout << "Error: attenuation list " << m << " is shorter than " <<
+            "the spectrum!\n";
+        return false;
+      }
+      for(int b = 0; b < num_bins; b++)
+      {
+        mu[(m*num_bins + b)] = mu_lists[m][(bins[b])];
+      }
+    }
+    for(int n = 0; n < cache.materials.size(); n++)
+    {
+      if(cache.materials[n] >= mu_lists.size())
+      {
+        std::cout << "Error: no attenuation list for material " <<
+            cache.materials[n] << "!\n";
+        return false;
+      }
+    }
+    
+    // Exponent of each bin summed over the ray's materials, then the
+    // weighted transmission
+    std::vector<double> exponent(num_bins);
+    for(int r = 0; r < cache.Size(); r++)
+    {
+      std::fill(exponent.begin(), exponent.end(), 0.0);
+      for(int n = cache.ray_begin[r]; n < cache.ray_begin[(r + 1)]; n++)
+      {
+        const double *mu_m = &mu[(cache.materials[n]*num_bins)];
+        double L = cache.lengths[n];
+        for(int b = 0; b < num_bins; b++) exponent[b] += mu_m[b]*L;
+      }
+      double total_sum = 0.0;
+      for(int b = 0; b < num_bins; b++)
+      {
+        total_sum += weights[b]*exp(-exponent[b]);
+      }
+      attenuations[r] = total_sum;
+    }
+    return true;
+  }
+  
+  void RayPathCache::Clear()
+  {
+    ray_begin.assign(1, 0);
+    materials.clear();
+    lengths.clear();
+  }
+  
+  // Lengths through the same material (e.g. from two objects) are merged
+  void RayPathCache::AddRay(const std::vector<double> &pathlengths,
+      const std::vector<int> &ray_materials)
+  {
+    if(ray_begin.empty()) ray_begin.push_back(0);
+    int begin = materials.size();
+    for(int n = 0; n < pathlengths.size(); n++)
+    {
+      if(!(pathlengths[n] > 0.0)) continue;
+      int k = begin;
+      while(k < materials.size() && materials[k] != ray_materials[n]) k++;
+      if(k < materials.size())
+      {
+        lengths[k] += pathlengths[n];
+      }
+      else
+      {
+        materials.push_back(ray_materials[n]);
+        lengths.push_back(pathlengths[n]);
+      }
+    }
+    ray_begin.push_back(materials.size());
+  }
+
+  // Sum up path lengths and attenuation coefficients
+  double ObjectModelXray::SpectrumAttenuation(
+      const std::vector<double> &pathlengths,
+      const std::vector<int> &ray_materials,
+      const std::vector<double> &spectrum, XrayRayScratch &scratch)
+  {
+    double total_sum = 0.0;
+    bool tabulated = IsListTabulated();
+    bool tabulated_source = tabulated && (&spectrum == &tabulated_spectrum);
+    if(tabulated_source && IsTransmissionTabulated() &&
+        TableTransmission(pathlengths, ray_materials, total_sum))
+    {
+      return total_sum;
+    }
+    if(tabulated_source && single_precision)
+    {
+      return SpectrumAttenuationFloat(pathlengths, ray_materials,
+          scratch.bin_values);
+    }
     for(int e = 0; e < spectrum.size(); e++){
       if(spectrum[e] == 0.0) continue;
       double energy_sum = 0.0;
       for(int n = 0; n < pathlengths.size(); n++){
-        if(!IsListTabulated())
+        if(!tabulated)
         {
-          energy_sum += (MuData[(ray_materials[n])].LinearAttenuation(double(e)) * pathlengths[n]);
+          energy_sum += (MuData[(ray_materials[n])].GridLinearAttenuation(e) * pathlengths[n]);
         }
         else
         {
@@ -179,6 +1030,61 @@ namespace solutio
     return total_sum;
   }
   
+  // exp(x) for x <= 0 in single precision, to about 2 ulp (arguments below
+  // -87 are clamped, giving exp(-87) = 1.6e-38). The argument is split as n*ln(2) + r with |r| <= ln(2)/2, and
+  // 2^n is built directly in the exponent bits. There are no branches, so
+  // loops calling it vectorize.
+  static inline float FastExp(float x)
+  {
+    x = 0.5f*(x - 87.0f + fabsf(x + 87.0f));
+    // Round to nearest for t <= 0
+    int n = int(x*1.44269504f - 0.5f);
+    float r = (x - n*0.693145752f) - n*1.42860677e-6f;
+    float p = 1.0f + r*(1.0f + r*(0.5f + r*(0.166666672f + r*(0.0416666679f +
+        r*(0.00833333377f + r*0.00138888892f)))));
+    int32_t bits = (n + 127) << 23;
+    float scale;
+    memcpy(&scale, &bits, sizeof(scale));
+    return p*scale;
+  }
+  
+  // Single precision spectrum sum: the exponent of every energy bin is
+  // accumulated over the ray's materials, then exponentiated, in loops over
+  // bins that vectorize at twice the width of double. Errors, relative to the
+  // total: rounding mu*L and the running exponent gives up to about
+  // 1.2e-7*(n_materials + 1)*(mu*L) per bin, FastExp 2.4e-7, and the final
+  // sum (eight partial sums of about 19 bins each) about 1.2e-6.
+  double ObjectModelXray::SpectrumAttenuationFloat(
+      const std::vector<double> &pathlengths,
+      const std::vector<int> &ray_materials, std::vector<float> &values)
+  {
+    int num_bins = float_spectrum.size();
+    if(num_bins == 0) return 0.0;
+    values.assign(num_bins, 0.0f);
+    float *exponent = &values[0];
+    for(int n = 0; n < pathlengths.size(); n++)
+    {
+      float L = pathlengths[n];
+      const float *mu = &float_mu_lists[(ray_materials[n]*num_bins)];
+      for(int b = 0; b < num_bins; b++) exponent[b] -= mu[b]*L;
+    }
+    const float *weight = &float_spectrum[0];
+    for(int b = 0; b < num_bins; b++)
+    {
+      exponent[b] = weight[b]*FastExp(exponent[b]);
+    }
+    // Partial sums, so the reduction vectorizes without reassociation
+    float partial[8] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+    int b = 0;
+    for(; b + 8 <= num_bins; b += 8)
+    {
+      for(int k = 0; k < 8; k++) partial[k] += exponent[(b + k)];
+    }
+    for(; b < num_bins; b++) partial[0] += exponent[b];
+    return ((partial[0] + partial[1]) + (partial[2] + partial[3])) +
+        ((partial[4] + partial[5]) + (partial[6] + partial[7]));
+  }
+  
   void ObjectModelXray::Print()
   {
     std::cout << "Materials\n";
@@ -35,13 +35,58 @@
 
 // Custom headers
 #include "Geometry/GeometricObjectModel.hpp"
+#include "Geometry/RayBatch.hpp"
 #include "Physics/NistPad.hpp"
 
 namespace solutio
 {
+  // Working buffers for the ray attenuation functions. Once they have grown
+  // to fit the model, tracing a ray does no heap allocation. A scratch must
+  // not be shared between threads; the overloads without one use a
+  // thread_local scratch.
+  struct XrayRayScratch
+  {
+    std::vector<double> pathlengths;
+    std::vector<int> ray_object_ids;
+    std::vector<int> ray_materials;
+    std::vector<char> ray_intersect;
+    std::vector<int> candidates;
+    // Batch intersections
+    std::vector<double> lengths;
+    std::vector<int> parent_slot;
+    std::vector<int> entry;
+    // Single precision spectrum sums
+    std::vector<float> bin_values;
+  };
+
+  // Polychromatic transmission against path length through one material, or
+  // through two (row-major, first material along rows), as log values. Node
+  // n lies at max_length*(n/(num_points-1))^2.
+  struct TransmissionTable
+  {
+    int num_points;
+    double max_length;
+    std::vector<double> log_transmission;
+  };
+
+  // Material path lengths of a set of rays, in compressed rows: ray r has
+  // materials[n] and lengths[n] for ray_begin[r] <= n < ray_begin[r + 1]
+  struct RayPathCache
+  {
+    RayPathCache(){ Clear(); }
+    int Size() const { return (ray_begin.size() - 1); }
+    void Clear();
+    void AddRay(const std::vector<double> &pathlengths,
+        const std::vector<int> &ray_materials);
+    std::vector<int> ray_begin;
+    std::vector<int> materials;
+    std::vector<double> lengths;
+  };
+
   class ObjectModelXray : public GeometricObjectModel
   {
     public:
+      ObjectModelXray();
       // Add a NistPad material
       void AddMaterial(std::string folder, std::string name);
       void AddMaterial(std::string folder, std::string name,
@@ -57,16 +102,118 @@ namespace solutio
       void TabulateAttenuationLists(std::vector<double> energies,
           std::vector<double> spectrum);
       bool IsListTabulated();
-      // Get fractional photon ray attenuation through object model
-      double GetRayAttenuation(Ray3 ray, std::vector<double> spectrum);
+      // The model's tabulated spectrum if spectrum equals it, otherwise
+      // spectrum itself. Spectrum sums only use the transmission tables and
+      // single precision for the returned reference, so callers evaluating
+      // many batches with one spectrum should match it once and pass the
+      // result on (each public call matches its spectrum again otherwise).
+      const std::vector<double> &MatchTabulatedSpectrum(
+          const std::vector<double> &spectrum);
+      // Create lookup tables of transmission for rays crossing only one or two
+      // materials (lengths up to max_length), refining each grid until the
+      // relative interpolation error is below tolerance. Rays crossing more
+      // materials, or longer paths, still use the full spectrum sum. If the
+      // tolerance cannot be reached, no tables are kept (returns false).
+      bool TabulateTransmission(double max_length, double tolerance = 1.0e-4);
+      bool IsTransmissionTabulated(){ return (transmission_1d.size() != 0); }
+      double GetTransmissionError(){ return transmission_error; }
+      // Reduce a spectrum on the 1 keV grid of the materials to at most
+      // max_nodes nonzero bins whose transmission through each material, and
+      // each pair of materials (lengths up to max_length, transmission down
+      // to 1e-6), is within tolerance (relative) of the full spectrum. The
+      // compressed spectrum is used in place of the original everywhere.
+      bool CompressSpectrum(const std::vector<double> &spectrum,
+          double max_length, double tolerance,
+          std::vector<double> &compressed, int max_nodes = 16);
+      double GetSpectrumError(){ return spectrum_error; }
+      // Evaluate full spectrum sums for the tabulated spectrum in single
+      // precision. The relative error is bounded by about
+      // 1.2e-7*(materials on the ray + 1)*(mu*L) + 1.5e-6, i.e. 2e-5 for
+      // mu*L = 50 through three materials (see SpectrumAttenuationFloat)
+      void SetSinglePrecision(bool single){ single_precision = single; }
+      bool IsSinglePrecision(){ return single_precision; }
+      // Get fractional photon ray attenuation through object model (derived
+      // models with other geometry override the scratch versions)
+      double GetRayAttenuation(Ray3 ray, const std::vector<double> &spectrum);
+      virtual double GetRayAttenuation(Ray3 ray,
+          const std::vector<double> &spectrum, XrayRayScratch &scratch);
+      // Same for a batch of rays, with each object intersected once per batch.
+      // Rays that only cross the world material take their attenuation from
+      // air_attenuations, if given, instead of a spectrum sum.
+      void GetRayAttenuations(const RayBatch &rays,
+          const std::vector<double> &spectrum, double *attenuations,
+          const double *air_attenuations = nullptr);
+      virtual void GetRayAttenuations(const RayBatch &rays,
+          const std::vector<double> &spectrum, double *attenuations,
+          XrayRayScratch &scratch, const double *air_attenuations = nullptr);
+      // Attenuation of a ray of the given length through the world material
+      // alone, evaluated as GetRayAttenuation would (e.g. to precompute
+      // air_attenuations for fixed source-detector distances)
+      double WorldAttenuation(double length,
+          const std::vector<double> &spectrum);
+      // Number of materials, and the electron density of a material relative
+      // to water (0 for an unknown index), e.g. to scale the path lengths of
+      // a RayPathCache to water-equivalent lengths
+      int GetNumMaterials(){ return MuData.size(); }
+      double GetRelativeElectronDensity(int material);
+      // Index of the material outside all objects (-1 if none)
+      int GetWorldMaterial(){ return WorldMaterial(); }
+      // Two-phase evaluation for several spectra: trace rays once, adding
+      // their material path lengths to a cache, then apply any spectrum (on
+      // the 1 keV grid of the materials, or the tabulated spectrum) or any
+      // attenuation lists (mu_lists[material][bin]) to the cached rays
+      void TraceRays(const RayBatch &rays, RayPathCache &cache);
+      virtual void TraceRays(const RayBatch &rays, RayPathCache &cache,
+          XrayRayScratch &scratch);
+      void ApplySpectrum(const RayPathCache &cache,
+          const std::vector<double> &spectrum, double *attenuations);
+      bool ApplySpectrum(const RayPathCache &cache,
+          const std::vector<double> &spectrum,
+          const std::vector< std::vector<double> > &mu_lists,
+          double *attenuations);
       //
       void Print();
+    protected:
+      // Index of a material in MuData (-1 if not found)
+      int FindMaterial(std::string material);
+      // Material outside all objects (-1 if none)
+      virtual int WorldMaterial();
+      // Polychromatic attenuation for path lengths through materials; the
+      // tabulated paths are taken when spectrum is tabulated_spectrum itself
+      // (see MatchTabulatedSpectrum)
+      double SpectrumAttenuation(const std::vector<double> &pathlengths,
+          const std::vector<int> &ray_materials,
+          const std::vector<double> &spectrum, XrayRayScratch &scratch);
+      std::vector<NistPad> MuData;
     private:
+      // Batch intersection, then the path length lists of ray r
+      void IntersectBatch(const RayBatch &rays, XrayRayScratch &scratch);
+      void BatchRayLists(const RayBatch &rays, int r, XrayRayScratch &scratch);
+      double SpectrumAttenuationFloat(const std::vector<double> &pathlengths,
+          const std::vector<int> &ray_materials, std::vector<float> &values);
+      bool TableTransmission(const std::vector<double> &pathlengths,
+          const std::vector<int> &ray_materials, double &transmission);
+      void TransmissionFactors(int material, const std::vector<double> &lengths,
+          std::vector<double> &factors);
       std::vector<std::string> object_material_name;
       std::vector<int> object_material_id;
-      std::vector<NistPad> MuData;
       std::vector<double> tabulated_energies;
       std::vector< std::vector<double> > tabulated_mu_lists;
+      std::vector<double> tabulated_spectrum;
+      // Single precision copies of the attenuation lists (material by
+      // material) and spectrum, for the nonzero bins of tabulated_spectrum
+      bool single_precision;
+      std::vector<float> float_mu_lists;
+      std::vector<float> float_spectrum;
+      // Transmission tables, per material and per material pair (a < b,
+      // stored at a*num_materials + b), for tabulated_spectrum
+      std::vector<int> spectrum_bins;
+      std::vector<TransmissionTable> transmission_1d;
+      std::vector<TransmissionTable> transmission_2d;
+      double transmission_length;
+      double transmission_error;
+      // Largest relative transmission error of the last compressed spectrum
+      double spectrum_error;
   };
 }
 
@@ -0,0 +1,154 @@
+/******************************************************************************/
+/*                                                                            */
+/* Copyright 2016-2017 Steven Dolly                                           */
+/*                                                                            */
+/* Licensed under the Apache License, Version 2.0 (the "License");            */
+/* you may not use this file except in compliance with the License.           */
+/* You may obtain a copy of the License at:                                   */
+/*                                                                            */
+/*     http://www.apache.org/licenses/LICENSE-2.0                             */
+/*                                                                            */
+/* Unless required by applicable law or agreed to in writing, software        */
+/* distributed under the License is distributed on an "AS IS" BASIS,          */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   */
+/* See the License for the specific language governing permissions and        */
+/* limitations under the License.                                             */
+/*                                                                            */
+/******************************************************************************/
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// ProjectionSink.cpp                                                         //
+// Projection Data Sink Class Source File                                     //
+// Created October 15, 2026                                                   //
+//                                                                            //
+// This file contains the source code for the in-memory, raw and MetaImage    //
+// projection data sinks.                                                     //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// Class header
+#include "ProjectionSink.hpp"
+
+// C++ headers
+#include <algorithm>
+#include <iostream>
+
+namespace solutio
+{
+  bool ProjectionBuffer::Open(int num_views, int num_rows, int num_channels)
+  {
+    view_size = num_rows*num_channels;
+    projection_data.assign(num_views*view_size, 0.0);
+    return true;
+  }
+  
+  bool ProjectionBuffer::WriteView(int view, const double *data)
+  {
+    std::copy(data, data + view_size, &projection_data[(view*view_size)]);
+    return true;
+  }
+  
+  bool ProjectionBuffer::Close()
+  {
+    return true;
+  }
+  
+  RawProjectionFile::RawProjectionFile(std::string file_name,
+      bool single_precision)
+  {
+    raw_file_name = file_name;
+    use_float = single_precision;
+    view_size = 0;
+  }
+  
+  bool RawProjectionFile::Open(int num_views, int num_rows, int num_channels)
+  {
+    view_size = num_rows*num_channels;
+    file.open(raw_file_name.c_str(), std::ios::out | std::ios::binary |
+        std::ios::trunc);
+    if(!file.is_open())
+    {
+      std::cout << "Error: could not open \"" << raw_file_name << "\"!\n";
+      return false;
+    }
+    // Allocate the whole file up front by writing its last byte
+    std::streamoff element_size = use_float ? sizeof(float) : sizeof(double);
+    std::streamoff file_size = element_size*num_views*view_size;
+    if(file_size > 0)
+    {
+      file.seekp(file_size - 1);
+      file.put('\0');
+    }
+    if(use_float) float_view.resize(view_size);
+    return file.good();
+  }
+  
+  bool RawProjectionFile::WriteView(int view, const double *data)
+  {
+    if(use_float)
+    {
+      std::copy(data, data + view_size, float_view.begin());
+      file.seekp(std::streamoff(view)*view_size*sizeof(float));
+      file.write(reinterpret_cast<const char*>(&float_view[0]),
+          view_size*sizeof(float));
+    }
+    else
+    {
+      file.seekp(std::streamoff(view)*view_size*sizeof(double));
+      file.write(reinterpret_cast<const char*>(data), view_size*sizeof(double));
+    }
+    if(!file.good())
+    {
+      std::cout << "Error: could not write view " << view << " to \"" <<
+          raw_file_name << "\"!\n";
+      return false;
+    }
+    return true;
+  }
+  
+  bool RawProjectionFile::Close()
+  {
+    file.close();
+    return !file.fail();
+  }
+  
+  MhdProjectionFile::MhdProjectionFile(std::string file_name,
+      bool single_precision) : RawProjectionFile(file_name, single_precision)
+  {
+    header_file_name = file_name;
+    size_t extension = file_name.rfind(".mhd");
+    if(extension != std::string::npos && extension + 4 == file_name.size())
+    {
+      raw_file_name = file_name.substr(0, extension) + ".raw";
+    }
+    else
+    {
+      raw_file_name = file_name + ".raw";
+    }
+  }
+  
+  bool MhdProjectionFile::Open(int num_views, int num_rows, int num_channels)
+  {
+    std::ofstream header(header_file_name.c_str());
+    if(!header.is_open())
+    {
+      std::cout << "Error: could not open \"" << header_file_name << "\"!\n";
+      return false;
+    }
+    // The header refers to the data file by its name within the same folder
+    std::string data_name = raw_file_name.substr(raw_file_name.rfind('/') + 1);
+    header << "ObjectType = Image\n";
+    header << "NDims = 3\n";
+    header << "DimSize = " << num_channels << ' ' << num_rows << ' ' <<
+        num_views << '\n';
+    header << "ElementType = " << (use_float ? "MET_FLOAT" : "MET_DOUBLE") <<
+        '\n';
+    header << "BinaryData = True\n";
+    header << "BinaryDataByteOrderMSB = False\n";
+    header << "ElementDataFile = " << data_name << '\n';
+    header.close();
+    if(header.fail()) return false;
+    return RawProjectionFile::Open(num_views, num_rows, num_channels);
+  }
+}
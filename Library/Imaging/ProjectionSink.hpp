@@ -0,0 +1,99 @@
+/******************************************************************************/
+/*                                                                            */
+/* Copyright 2016-2017 Steven Dolly                                           */
+/*                                                                            */
+/* Licensed under the Apache License, Version 2.0 (the "License");            */
+/* you may not use this file except in compliance with the License.           */
+/* You may obtain a copy of the License at:                                   */
+/*                                                                            */
+/*     http://www.apache.org/licenses/LICENSE-2.0                             */
+/*                                                                            */
+/* Unless required by applicable law or agreed to in writing, software        */
+/* distributed under the License is distributed on an "AS IS" BASIS,          */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   */
+/* See the License for the specific language governing permissions and        */
+/* limitations under the License.                                             */
+/*                                                                            */
+/******************************************************************************/
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// ProjectionSink.hpp                                                         //
+// Projection Data Sink Class Header File                                     //
+// Created October 15, 2026                                                   //
+//                                                                            //
+// This header file contains the interface that receives CT projection data   //
+// one view at a time as it is acquired, with sinks that keep the views in    //
+// memory or write them to preallocated raw or MetaImage (.mhd/.raw) files,   //
+// so that long scans need not be held in memory.                             //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// Header guard
+#ifndef PROJECTIONSINK_HPP
+#define PROJECTIONSINK_HPP
+
+// Standard C++ header files
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace solutio
+{
+  // Receiver for views (rows x channels) of a sinogram
+  class ProjectionSink
+  {
+    public:
+      virtual ~ProjectionSink(){}
+      // Called once before the first view with the sinogram dimensions
+      virtual bool Open(int num_views, int num_rows, int num_channels) = 0;
+      // Called for every view, in order, from a single thread
+      virtual bool WriteView(int view, const double *data) = 0;
+      // Called once after the last view
+      virtual bool Close() = 0;
+  };
+  
+  // Keeps the whole sinogram in memory (views x rows x channels)
+  class ProjectionBuffer : public ProjectionSink
+  {
+    public:
+      bool Open(int num_views, int num_rows, int num_channels);
+      bool WriteView(int view, const double *data);
+      bool Close();
+      std::vector<double> &GetData(){ return projection_data; }
+    private:
+      int view_size;
+      std::vector<double> projection_data;
+  };
+  
+  // Headerless binary file (little-endian on x86), in double or single
+  // precision, sized for the whole sinogram when opened
+  class RawProjectionFile : public ProjectionSink
+  {
+    public:
+      RawProjectionFile(std::string file_name, bool single_precision = false);
+      virtual bool Open(int num_views, int num_rows, int num_channels);
+      bool WriteView(int view, const double *data);
+      bool Close();
+    protected:
+      std::string raw_file_name;
+      bool use_float;
+      int view_size;
+      std::ofstream file;
+      std::vector<float> float_view;
+  };
+  
+  // MetaImage header (file_name, ending in .mhd) next to a raw data file with
+  // the same name ending in .raw
+  class MhdProjectionFile : public RawProjectionFile
+  {
+    public:
+      MhdProjectionFile(std::string file_name, bool single_precision = false);
+      bool Open(int num_views, int num_rows, int num_channels);
+    private:
+      std::string header_file_name;
+  };
+}
+
+// End header guard
+#endif
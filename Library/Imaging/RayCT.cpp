@@ -33,17 +33,35 @@
 #include "RayCT.hpp"
 
 // C++ headers
+#include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <thread>
 
 // C headers
 #include <cstdlib>
 
 // Custom headers
 #include "Tasmip.hpp"
+#include "Geometry/RayBatch.hpp"
+#include "Utilities/ParallelFor.hpp"
+#include "Utilities/RandomNumbers.hpp"
 
 namespace solutio
 {
+  RayCT::RayCT()
+  {
+    num_threads = 1;
+    tile_rows = 1;
+    tile_channels = 64;
+    transmission_tolerance = 0.0;
+    single_precision = false;
+    spectrum_tolerance = 0.0;
+    spectrum_nodes = 16;
+    noise_seed = 0;
+    noise_stream = 0;
+  }
+  
   void RayCT::SetNistDataFolder(std::string folder)
   {
     data_folder = folder;
@@ -64,7 +82,21 @@ namespace solutio
     d_fan_angle = (2.0*channel_width) / (2.0*scanner_radius);
     fov = 2.0*scanner_radius*sin(0.5*fan_angle);
     
-    std::cout << fan_angle << '\t' << d_fan_angle << '\t' << fov << '\n';
+    // Tabulate detector element positions, so that the rays of every view
+    // only need to be rotated
+    channel_x.resize(num_channels);
+    channel_y.resize(num_channels);
+    for(int c = 0; c < num_channels; c++)
+    {
+      double gamma = M_PI - fan_angle/2.0 + d_fan_angle/2.0 + c*d_fan_angle;
+      channel_x[c] = scanner_radius*(2.0*cos(gamma) + 1.0);
+      channel_y[c] = 2.0*scanner_radius*sin(gamma);
+    }
+    row_z.resize(num_rows);
+    for(int r = 0; r < num_rows; r++)
+    {
+      row_z[r] = 2.0*row_width * (double(r) - (double(num_rows)/2.0) + 0.5);
+    }
   }
   
   void RayCT::SetAcquisition(int kVp, double photons, int projs)
@@ -72,50 +104,90 @@ namespace solutio
     tube_potential = kVp;
     num_photons = photons;
     num_projections = projs;
+    
+    // Tabulate the view rotations
+    view_cos.resize(num_projections);
+    view_sin.resize(num_projections);
+    for(int n = 0; n < num_projections; n++)
+    {
+      double a = (2.0*M_PI*n)/num_projections;
+      view_cos[n] = cos(a);
+      view_sin[n] = sin(a);
+    }
+  }
+  
+  void RayCT::SetNumThreads(int threads)
+  {
+    num_threads = threads;
+  }
+  
+  void RayCT::SetTransmissionTolerance(double tolerance)
+  {
+    transmission_tolerance = tolerance;
+  }
+  
+  void RayCT::SetSinglePrecision(bool single)
+  {
+    single_precision = single;
+  }
+  
+  void RayCT::SetSpectrumQuadrature(double tolerance, int max_nodes)
+  {
+    spectrum_tolerance = tolerance;
+    spectrum_nodes = max_nodes;
   }
   
-  double RayCT::RandNormal(double mean, double stddev)
+  // Detector tiles are the unit of parallel work; each one is a block of
+  // (rows x channels) detector elements from a single view
+  void RayCT::SetDetectorTile(int rows, int channels)
   {
-    static double n2 = 0.0;
-    static int n2_cached = 0;
-    if(!n2_cached)
+    if(rows < 1 || channels < 1)
     {
-      double x, y, r;
-      do
-      {
-        x = 2.0*rand()/RAND_MAX - 1;
-        y = 2.0*rand()/RAND_MAX - 1;
-        r = x*x + y*y;
-      }
-      while (r == 0.0 || r > 1.0);
-      {
-        double d = sqrt(-2.0*log(r)/r);
-        double n1 = x*d;
-        n2 = y*d;
-        double result = n1*stddev + mean;
-        n2_cached = 1;
-        return result;
-      }
+      std::cout << "Error: detector tile must contain at least one element!\n";
+      return;
     }
-    else
+    tile_rows = rows;
+    tile_channels = channels;
+  }
+  
+  void RayCT::SetNoiseSeed(uint64_t seed)
+  {
+    noise_seed = seed;
+    noise_stream = 0;
+  }
+  
+  // The random numbers for each detector element come from their own Philox
+  // stream, keyed by (seed, view, row, channel) and the number of earlier
+  // noise calls, so the result does not depend on the number of threads
+  void RayCT::AddElementNoise(double *signal, int view, int row,
+      int channel_begin, int channel_end, uint32_t stream)
+  {
+    for(int c = channel_begin; c < channel_end; c++)
     {
-      n2_cached = 0;
-      return n2*stddev + mean;
+      PhiloxStream random(noise_seed, c, row, view, stream);
+      double input = random.Poisson(signal[c]);   // Photon statistics
+      input += random.Normal(0.0, sqrt(10.0));    // Electronic noise
+      if(input <= 0.0) input = 0.1;
+      signal[c] = input;
     }
   }
   
   void RayCT::AddPoissonNoise(std::vector<double> &projection)
   {
-    double input;
-    srand(time(0));
-    for(int p = 0; p < projection.size(); p++)
+    int view_size = num_rows*num_channels;
+    if(view_size == 0 || projection.size() % view_size != 0)
     {
-      input = projection[p];
-      input += RandNormal(input, sqrt(input)); // Photon statistics
-      input += RandNormal(0.0, sqrt(10.0));    // Electronic noise
-      if(input <= 0.0) input = 0.1;
-      projection[p] = input;
+      std::cout << "Error: projection data does not match scanner geometry!\n";
+      return;
     }
+    uint32_t stream = noise_stream++;
+    int num_views = projection.size() / view_size;
+    ParallelFor(num_views*num_rows, num_threads,
+        [&](int task, int thread_id)
+    {
+      AddElementNoise(&projection[(task*num_channels)], task / num_rows,
+          task % num_rows, 0, num_channels, stream);
+    });
   }
   
   std::vector<double> RayCT::AcquireAirScan()
@@ -130,39 +202,32 @@ namespace solutio
     std::vector<double> air_data_table;
     air_data_table.push_back(0.0);
     NistPad Air(data_folder, "Air");
+    Air.TabulateEnergyGrid(0.0, 0.150, 151);
     for(int e = 1; e < 151; e++)
     {
-      air_data_table.push_back(Air.LinearAttenuation(energies[e]/1000.0));
+      air_data_table.push_back(Air.GridLinearAttenuation(e));
     }
     
     // Initialize projection data container
-    std::vector<double> air_scan_proj;
+    std::vector<double> air_scan_proj(num_rows*num_channels);
     
-    // Set source position
-    double source_angle;
-    Vec3<double> source_position;
-    source_angle = 0.0*(M_PI/180.0);
-    source_position.Set(scanner_radius*cos(source_angle),
-        scanner_radius*sin(source_angle), 0.0);
+    // Source at angle 0, so the tabulated detector positions need no rotation
+    Vec3<double> source_position(scanner_radius, 0.0, 0.0);
     
     // Acquire mean signal at each detector element from source    
     Ray3 source_ray;
-    double gamma, x, y, L, sum;
+    double L, sum;
     Vec3<double> detector_pos;
     for(int r = 0; r < num_rows; r++){
       for(int c = 0; c < num_channels; c++){
-        x = scanner_radius*(2.0*cos((M_PI - fan_angle/2.0 + d_fan_angle/2.0 + c*d_fan_angle)) + 1.0);
-        y = 2.0*scanner_radius*sin((M_PI - fan_angle/2.0 + d_fan_angle/2.0 + c*d_fan_angle));
-        detector_pos.x = x*cos(source_angle) - y*sin(source_angle);
-        detector_pos.y = x*sin(source_angle) + y*cos(source_angle);
-        detector_pos.z = 2.0*row_width * (double(r) - (double(num_rows)/2.0) + 0.5);
+        detector_pos.Set(channel_x[c], channel_y[c], row_z[r]);
         source_ray.SetRay(source_position, detector_pos - source_position);
         L = source_ray.GetLength();
         sum = 0.0;
         for(int e = 0; e < source_spectrum.size(); e++){
           sum += (source_spectrum[e] * exp(-air_data_table[e]*L));
         }
-        air_scan_proj.push_back(sum);
+        air_scan_proj[(r*num_channels + c)] = sum;
       }
     }
     
@@ -183,89 +248,217 @@ namespace solutio
   std::vector<double> RayCT::ObjectProjection(ObjectModelXray &M, double angle,
       double z, std::vector<double> spectrum)
   {
-    std::vector<double> projection;
-    double gamma, x0, y0, x1, y1;
-    Vec3<double> source_position, detector_pos;
-    Ray3 source_ray;
-    
+    std::vector<double> projection(num_rows*num_channels);
+    const std::vector<double> &source = M.MatchTabulatedSpectrum(spectrum);
+    // The view's detector tiles are acquired in parallel
+    double cos_a = cos(angle), sin_a = sin(angle);
+    int row_tiles = (num_rows + tile_rows - 1) / tile_rows;
+    int channel_tiles = (num_channels + tile_channels - 1) / tile_channels;
+    ParallelFor(row_tiles*channel_tiles, num_threads,
+        [&](int tile, int thread_id)
+    {
+      int r0 = (tile / channel_tiles)*tile_rows;
+      int c0 = (tile % channel_tiles)*tile_channels;
+      int r1 = std::min(r0 + tile_rows, num_rows);
+      int c1 = std::min(c0 + tile_channels, num_channels);
+      ProjectDetectorTile(M, cos_a, sin_a, z, source, nullptr, r0, r1, c0,
+          c1, &projection[0]);
+    });
+    return projection;
+  }
+  
+  std::vector<double> RayCT::AirAttenuations(ObjectModelXray &M,
+      const std::vector<double> &spectrum)
+  {
+    std::vector<double> air(num_rows*num_channels);
+    ParallelFor(num_rows, num_threads, [&](int r, int thread_id)
+    {
+      for(int c = 0; c < num_channels; c++)
+      {
+        double d_x = channel_x[c] - scanner_radius;
+        double length = sqrt(d_x*d_x + channel_y[c]*channel_y[c] +
+            row_z[r]*row_z[r]);
+        air[(r*num_channels + c)] = M.WorldAttenuation(length, spectrum);
+      }
+    });
+    return air;
+  }
+  
+  void RayCT::ProjectDetectorTile(ObjectModelXray &M, double cos_a,
+      double sin_a, double z, const std::vector<double> &spectrum,
+      const double *air, int row_begin, int row_end, int channel_begin,
+      int channel_end, double *projection)
+  {
     // Set source position (z position always equal to 0)
-    x0 = scanner_radius*cos(angle);// + (-1.0*0.5*channel_width*sin(angle));
-    y0 = scanner_radius*sin(angle);// + (0.5*channel_width*cos(angle));
-    source_position.Set(x0, y0, z);
+    double x0 = scanner_radius*cos_a;
+    double y0 = scanner_radius*sin_a;
   
-    // Calculate attenuation for each source ray
-    for(int r = 0; r < num_rows; r++){
-      for(int c = 0; c < num_channels; c++){
-        // Set initial detector coordinates
-        Ray3 source_ray;
-        x1 = scanner_radius*(2.0*cos((M_PI - fan_angle/2.0 + d_fan_angle/2.0
-            + c*d_fan_angle)) + 1.0);
-        y1 = 2.0*scanner_radius*sin((M_PI - fan_angle/2.0 + d_fan_angle/2.0
-            + c*d_fan_angle));
-        // Rotate to source angle
-        detector_pos.x = x1*cos(angle) - y1*sin(angle);
-        detector_pos.y = x1*sin(angle) + y1*cos(angle);
-        detector_pos.z = z + (2.0*row_width * (double(r) -
-            (double(num_rows)/2.0) + 0.5));
-        // Shift for 1/4 detector offset
-        //detector_pos.x += (-1.0*0.5*channel_width*sin(angle));
-        //detector_pos.y += (0.5*channel_width*cos(angle));
-        // Assign ray parameters
-        source_ray.SetRay(source_position, detector_pos - source_position);
-        
-        // Find path length for each tissue ray passes through  
-        double intensity = M.GetRayAttenuation(source_ray, spectrum);
-        projection.push_back(intensity);
+    // Gather the tile's source rays into one batch; the in-plane direction
+    // depends only on the channel and the z direction only on the row
+    int batch_channels = channel_end - channel_begin;
+    static thread_local RayBatch source_rays;
+    source_rays.Resize((row_end - row_begin)*batch_channels);
+    for(int r = row_begin; r < row_end; r++){
+      // Detector z minus source z, rounded as the element position
+      double dz = (z + row_z[r]) - z;
+      int n = (r - row_begin)*batch_channels - channel_begin;
+      for(int c = channel_begin; c < channel_end; c++){
+        // Rotate the detector element to the source angle
+        source_rays.origin_x[n + c] = x0;
+        source_rays.origin_y[n + c] = y0;
+        source_rays.origin_z[n + c] = z;
+        source_rays.direction_x[n + c] =
+            (channel_x[c]*cos_a - channel_y[c]*sin_a) - x0;
+        source_rays.direction_y[n + c] =
+            (channel_x[c]*sin_a + channel_y[c]*cos_a) - y0;
+        source_rays.direction_z[n + c] = dz;
       }
     }
     
-    return projection;
+    // Find path length for each tissue the rays pass through
+    static thread_local std::vector<double> attenuations, tile_air;
+    attenuations.resize(source_rays.Size());
+    if(air != nullptr)
+    {
+      tile_air.resize(source_rays.Size());
+      for(int r = row_begin; r < row_end; r++){
+        std::copy(air + r*num_channels + channel_begin,
+            air + r*num_channels + channel_end,
+            &tile_air[((r - row_begin)*batch_channels)]);
+      }
+    }
+    M.GetRayAttenuations(source_rays, spectrum, &attenuations[0],
+        (air != nullptr) ? &tile_air[0] : nullptr);
+    for(int r = row_begin; r < row_end; r++){
+      for(int c = channel_begin; c < channel_end; c++){
+        projection[(r*num_channels + c)] =
+            attenuations[((r - row_begin)*batch_channels + (c - channel_begin))];
+      }
+    }
   }
   
-  std::vector<double> RayCT::AcquireAxialProjections(ObjectModelXray &M,
-      double z)
+  std::vector<double> RayCT::PrepareSpectrum(ObjectModelXray &M)
   {
     // Set source spectrum and attenuation lists
     std::vector<double> energies;
     for(int e = 0; e < 151; e++){ energies.push_back(double(e)/1000.0); }
     std::vector<double> source_spectrum = Tasmip(tube_potential, 0.0,
         "Aluminum", data_folder);
+    // Longest source-detector ray, from the center of the arc to the
+    // outermost row
+    double max_length = 1.001*sqrt(pow(2.0*scanner_radius, 2.0) +
+        pow(row_width*num_rows, 2.0));
+    if(spectrum_tolerance > 0.0)
+    {
+      // The compressed spectrum is only used within the tolerance
+      std::vector<double> compressed;
+      if(M.CompressSpectrum(source_spectrum, max_length, spectrum_tolerance,
+          compressed, spectrum_nodes))
+      {
+        source_spectrum = compressed;
+      }
+      else
+      {
+        std::cout << "Warning: projecting with the full spectrum!\n";
+      }
+    }
     if(!M.IsListTabulated())
     {
       M.TabulateAttenuationLists(energies, source_spectrum);
+      if(transmission_tolerance > 0.0)
+      {
+        if(!M.TabulateTransmission(max_length, transmission_tolerance))
+        {
+          std::cout << "Warning: using full spectrum sums for all rays!\n";
+        }
+      }
     }
     else
     {
       std::cout << "Warning: attenuation list already tabulated!\n";
     }
-    
-    // Initialize projection data container
+    M.SetSinglePrecision(single_precision);
+    return source_spectrum;
+  }
+  
+  std::vector<double> RayCT::AcquireAxialProjections(ObjectModelXray &M,
+      double z)
+  {
+    ProjectionBuffer buffer;
     std::vector<double> projection_data;
-    
-    // Acquire projection at every angle
-    double a;
-    for(int n = 0; n < num_projections; n++)
+    if(AcquireAxialProjections(M, z, buffer))
     {
-      a = (2.0*M_PI*n)/num_projections;
-      std::cout << "Simulating projection " << (n+1) << " of " << num_projections << '\n';
-      std::vector<double> proj = ObjectProjection(M, a, z, source_spectrum);
-      for(int p = 0; p < proj.size(); p++)
-      {
-        projection_data.push_back(proj[p]);
-      }
+      projection_data.swap(buffer.GetData());
     }
+    return projection_data;
+  }
+  
+  bool RayCT::AcquireAxialProjections(ObjectModelXray &M, double z,
+      ProjectionSink &sink)
+  {
+    // Matched to the model's tabulated spectrum once for all rays
+    std::vector<double> source_spectrum = PrepareSpectrum(M);
+    const std::vector<double> &spectrum =
+        M.MatchTabulatedSpectrum(source_spectrum);
+    std::vector<double> air = AirAttenuations(M, spectrum);
+    int view_size = num_rows*num_channels;
+    if(!sink.Open(num_projections, num_rows, num_channels)) return false;
     
-    // Scale, add noise and spatial blurring
-    double value;
-    for(int n = 0; n < projection_data.size(); n++)
+    // Split every view into detector tiles and acquire all tiles of a group
+    // of views in parallel; each tile writes only to its own elements, and
+    // is scaled and given noise there, so the result does not depend on the
+    // number of threads
+    int row_tiles = (num_rows + tile_rows - 1) / tile_rows;
+    int channel_tiles = (num_channels + tile_channels - 1) / tile_channels;
+    int tiles_per_view = row_tiles*channel_tiles;
+    int group_size = ResolveThreadCount(num_threads);
+    uint32_t stream = noise_stream++;
+    std::cout << "Simulating " << num_projections << " projections using " <<
+        ResolveThreadCount(num_threads) << " thread(s)\n";
+    
+    // Groups alternate between two buffers: while one group is acquired, the
+    // writer thread passes the previous one to the sink
+    std::vector<double> group_data[2];
+    group_data[0].resize(group_size*view_size);
+    group_data[1].resize(group_size*view_size);
+    std::thread writer;
+    bool write_ok = true;
+    for(int first = 0, g = 0; first < num_projections; first += group_size, g++)
     {
-      value = projection_data[n];
-      value *= num_photons;
-      projection_data[n] = value;
+      int count = std::min(group_size, num_projections - first);
+      double *group = &group_data[g % 2][0];
+      ParallelFor(count*tiles_per_view, num_threads,
+          [&](int task, int thread_id)
+      {
+        int n = first + task / tiles_per_view;
+        int tile = task % tiles_per_view;
+        int r0 = (tile / channel_tiles)*tile_rows;
+        int c0 = (tile % channel_tiles)*tile_channels;
+        int r1 = std::min(r0 + tile_rows, num_rows);
+        int c1 = std::min(c0 + tile_channels, num_channels);
+        double *view = group + (n - first)*view_size;
+        ProjectDetectorTile(M, view_cos[n], view_sin[n], z, spectrum,
+            &air[0], r0, r1, c0, c1, view);
+        // Scale and add noise
+        for(int r = r0; r < r1; r++)
+        {
+          double *signal = view + r*num_channels;
+          for(int c = c0; c < c1; c++) signal[c] *= num_photons;
+          AddElementNoise(signal, n, r, c0, c1, stream);
+        }
+      });
+      if(writer.joinable()) writer.join();
+      if(!write_ok) break;
+      writer = std::thread([&sink, &write_ok, group, first, count, view_size]()
+      {
+        for(int v = 0; v < count && write_ok; v++)
+        {
+          write_ok = sink.WriteView(first + v, group + v*view_size);
+        }
+      });
     }
-    AddPoissonNoise(projection_data);
+    if(writer.joinable()) writer.join();
     
-    // Return projection data
-    return projection_data;
+    return sink.Close() && write_ok;
   }
 }
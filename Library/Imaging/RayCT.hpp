@@ -34,26 +34,70 @@
 #define RAYCT_HPP
 
 // C++ headers
+#include <cstdint>
 #include <vector>
 #include <string>
 
 // Custom headers
 #include "Imaging/ObjectModelXray.hpp"
+#include "Imaging/ProjectionSink.hpp"
 
 namespace solutio {
   class RayCT
   {
     public:
+      RayCT();
       void SetNistDataFolder(std::string folder);
       void SetGeometry(double radius, int n_c, double d_c, int n_r, double d_r);
       void SetAcquisition(int kVp, double photons, int projs);
-      double RandNormal(double mean, double stddev);
+      // Parallel acquisition settings (0 threads = all hardware threads)
+      void SetNumThreads(int threads);
+      void SetDetectorTile(int rows, int channels);
+      // Use transmission lookup tables for rays through one or two materials
+      // (tolerance is the relative error allowed; 0 = exact spectrum sums)
+      void SetTransmissionTolerance(double tolerance);
+      // Use single precision spectrum sums (ObjectModelXray::
+      // SetSinglePrecision), for bulk data generation
+      void SetSinglePrecision(bool single);
+      // Project with a spectrum compressed to at most max_nodes energies
+      // (ObjectModelXray::CompressSpectrum), with transmission through the
+      // model's materials within tolerance (relative) of the full spectrum;
+      // 0 = full spectrum. The full spectrum is also kept if the tolerance
+      // cannot be reached. The air scan always uses the full spectrum.
+      void SetSpectrumQuadrature(double tolerance, int max_nodes = 16);
+      // Seed for detector noise; each call to AddPoissonNoise after it draws
+      // a new, reproducible noise realization
+      void SetNoiseSeed(uint64_t seed);
+      // Replace mean signals (views x rows x channels) with Poisson photon
+      // counts plus Gaussian electronic noise
       void AddPoissonNoise(std::vector<double> &projection);
       std::vector<double> AcquireAirScan();
       std::vector<double> ObjectProjection(ObjectModelXray &M, double angle,
           double z, std::vector<double> spectrum);
       std::vector<double> AcquireAxialProjections(ObjectModelXray &M, double z);
+      // Stream the views of an axial scan to a sink as they are finished,
+      // writing one group of views while the next is acquired; only two
+      // groups of views (one view per thread each) are held in memory
+      bool AcquireAxialProjections(ObjectModelXray &M, double z,
+          ProjectionSink &sink);
     private:
+      // Source spectrum, with the model's attenuation lists tabulated for it
+      std::vector<double> PrepareSpectrum(ObjectModelXray &M);
+      // Noise for the channels [channel_begin, channel_end) of one row
+      void AddElementNoise(double *signal, int view, int row,
+          int channel_begin, int channel_end, uint32_t stream);
+      // Attenuation of each detector element's ray through the world
+      // material alone (rows x channels); the source-detector distance is
+      // the same in every view
+      std::vector<double> AirAttenuations(ObjectModelXray &M,
+          const std::vector<double> &spectrum);
+      // Fill one rectangular tile of detector elements for a single view,
+      // with the source at angle (cos_a, sin_a); rays missing every object
+      // take their value from air (rows x channels) if given
+      void ProjectDetectorTile(ObjectModelXray &M, double cos_a, double sin_a,
+          double z, const std::vector<double> &spectrum, const double *air,
+          int row_begin, int row_end, int channel_begin, int channel_end,
+          double *projection);
       // Data folder for NISTX data
       std::string data_folder;
       // Scanner geometry parameters
@@ -66,10 +110,27 @@ namespace solutio {
       int tube_potential;
       double num_photons;
       int num_projections;
+      // Parallel acquisition parameters
+      int num_threads;
+      int tile_rows;
+      int tile_channels;
+      double transmission_tolerance;
+      bool single_precision;
+      double spectrum_tolerance;
+      int spectrum_nodes;
+      // Noise parameters
+      uint64_t noise_seed;
+      uint32_t noise_stream;
       // Derived parameters
       double fan_angle;
       double d_fan_angle;
       double fov;
+      // Detector geometry tables: channel positions on the arc before the
+      // view rotation (source on the +x axis), row offsets along z, and the
+      // rotation of every view of an axial acquisition
+      std::vector<double> channel_x, channel_y;
+      std::vector<double> row_z;
+      std::vector<double> view_cos, view_sin;
   };
 }
 
@@ -217,11 +217,12 @@ namespace solutio
       0,0,0,0,
     };
 
-    // Aluminum attenuation data, from NIST database
+    // Aluminum attenuation data, from NIST database, on the 1 keV grid
     NistPad NistAl(folder, filter_material);
+    NistAl.TabulateEnergyGrid(0.0, 0.150, 151);
 	
     // Generate spectrum for selected kVp value and Al thickness
-    double energy, sum, mu, attenuation;
+    double sum, mu, attenuation;
     for(int n = 0; n < 151; n++){
       if( (num_polynomial_terms[n] == 0) || (n >= tube_potential) ){
         spectrum.push_back(0.0);
@@ -229,8 +230,7 @@ namespace solutio
       }
       else {
         // Calculate attenuation by filtration
-        energy = double(n) / 1000.0;
-        mu = NistAl.LinearAttenuation(energy);
+        mu = NistAl.GridLinearAttenuation(n);
         attenuation = exp(-mu*mm_filtration*0.1);
 
         // Calculate spectrum using TASMIP polynomials and apply filtration
@@ -0,0 +1,343 @@
+/******************************************************************************/
+/*                                                                            */
+/* Copyright 2016-2017 Steven Dolly                                           */
+/*                                                                            */
+/* Licensed under the Apache License, Version 2.0 (the "License");            */
+/* you may not use this file except in compliance with the License.           */
+/* You may obtain a copy of the License at:                                   */
+/*                                                                            */
+/*     http://www.apache.org/licenses/LICENSE-2.0                             */
+/*                                                                            */
+/* Unless required by applicable law or agreed to in writing, software        */
+/* distributed under the License is distributed on an "AS IS" BASIS,          */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   */
+/* See the License for the specific language governing permissions and        */
+/* limitations under the License.                                             */
+/*                                                                            */
+/******************************************************************************/
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// VoxelModelXray.cpp                                                         //
+// Voxelized X-ray Object Model Class Source File                             //
+// Created October 15, 2026                                                   //
+//                                                                            //
+// This file contains the source code for the voxelized x-ray object model.   //
+// Rays are traced incrementally (Siddon, Med. Phys. 12, 1985) from voxel     //
+// boundary to voxel boundary, adding each intersection length to the         //
+// material of the voxel, so every ray is traced once for all materials.      //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// Class header
+#include "VoxelModelXray.hpp"
+
+// C++ headers
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+namespace solutio
+{
+  VoxelModelXray::VoxelModelXray()
+  {
+    size_x = size_y = size_z = 0;
+    bricks_x = bricks_y = bricks_z = 0;
+    label_material.assign(256, -1);
+    background_material = -1;
+  }
+  
+  bool VoxelModelXray::SetVolume(int nx, int ny, int nz,
+      Vec3<double> voxel_size, Vec3<double> corner,
+      const std::vector<unsigned char> &labels)
+  {
+    if(nx < 1 || ny < 1 || nz < 1 || labels.size() != size_t(nx)*ny*nz)
+    {
+      std::cout << "Error: label volume does not match its dimensions!\n";
+      return false;
+    }
+    if(!(voxel_size.x > 0.0 && voxel_size.y > 0.0 && voxel_size.z > 0.0))
+    {
+      std::cout << "Error: voxel size must be positive!\n";
+      return false;
+    }
+    size_x = nx;
+    size_y = ny;
+    size_z = nz;
+    voxel = voxel_size;
+    lower = corner;
+    upper.Set(corner.x + nx*voxel.x, corner.y + ny*voxel.y,
+        corner.z + nz*voxel.z);
+    
+    // Copy the labels into bricks, padding partial bricks with label 0
+    bricks_x = (nx + 7) >> 3;
+    bricks_y = (ny + 7) >> 3;
+    bricks_z = (nz + 7) >> 3;
+    voxel_labels.assign(size_t(bricks_x)*bricks_y*bricks_z*512, 0);
+    for(int k = 0; k < nz; k++)
+    {
+      for(int j = 0; j < ny; j++)
+      {
+        for(int i = 0; i < nx; i++)
+        {
+          voxel_labels[(BrickedIndex(i, j, k))] =
+              labels[((size_t(k)*ny + j)*nx + i)];
+        }
+      }
+    }
+    voxel_density.clear();
+    return true;
+  }
+  
+  bool VoxelModelXray::AssignLabel(int label, std::string material)
+  {
+    int m = FindMaterial(material);
+    if(label < 0 || label > 255 || m < 0)
+    {
+      std::cout << "Error: could not assign material \"" << material <<
+          "\" to label " << label << "!\n";
+      return false;
+    }
+    label_material[label] = m;
+    return true;
+  }
+  
+  bool VoxelModelXray::SetDensityScale(const std::vector<float> &scale)
+  {
+    if(scale.size() != size_t(size_x)*size_y*size_z)
+    {
+      std::cout << "Error: density volume does not match label volume!\n";
+      return false;
+    }
+    voxel_density.assign(voxel_labels.size(), 0.0f);
+    for(int k = 0; k < size_z; k++)
+    {
+      for(int j = 0; j < size_y; j++)
+      {
+        for(int i = 0; i < size_x; i++)
+        {
+          voxel_density[(BrickedIndex(i, j, k))] =
+              scale[((size_t(k)*size_y + j)*size_x + i)];
+        }
+      }
+    }
+    return true;
+  }
+  
+  bool VoxelModelXray::SetHounsfieldVolume(int nx, int ny, int nz,
+      Vec3<double> voxel_size, Vec3<double> corner,
+      const std::vector<short> &hu, const std::vector<double> &thresholds,
+      const std::vector<std::string> &materials)
+  {
+    if(thresholds.size() != materials.size() || materials.size() > 255)
+    {
+      std::cout << "Error: need one HU threshold per material!\n";
+      return false;
+    }
+    // Label k + 1 for materials[k], label 0 for vacuum
+    std::vector<double> density(materials.size());
+    for(int k = 0; k < materials.size(); k++)
+    {
+      if(!AssignLabel(k + 1, materials[k])) return false;
+      density[k] = MuData[(label_material[(k + 1)])].GetDensity();
+    }
+    std::vector<unsigned char> labels(hu.size(), 0);
+    std::vector<float> scale(hu.size(), 0.0f);
+    for(size_t n = 0; n < hu.size(); n++)
+    {
+      int k = std::upper_bound(thresholds.begin(), thresholds.end(),
+          double(hu[n])) - thresholds.begin();
+      if(k == 0) continue;
+      labels[n] = k;
+      scale[n] = std::max(0.0, 1.0 + hu[n]/1000.0)/density[(k - 1)];
+    }
+    if(!SetVolume(nx, ny, nz, voxel_size, corner, labels)) return false;
+    return SetDensityScale(scale);
+  }
+  
+  bool VoxelModelXray::SetBackgroundMaterial(std::string material)
+  {
+    background_material = FindMaterial(material);
+    if(background_material < 0)
+    {
+      std::cout << "Error: could not find element/material!\n";
+      return false;
+    }
+    return true;
+  }
+  
+  // Siddon's method: the ray is clipped to the volume, then stepped from one
+  // voxel boundary to the next along whichever axis is crossed first
+  bool VoxelModelXray::VolumeRange(const double *origin,
+      const double *direction, double &t_in, double &t_out)
+  {
+    double low[3] = {lower.x, lower.y, lower.z};
+    double high[3] = {upper.x, upper.y, upper.z};
+    t_in = 0.0;
+    t_out = 1.0;
+    for(int a = 0; a < 3; a++)
+    {
+      if(direction[a] == 0.0)
+      {
+        if(origin[a] < low[a] || origin[a] >= high[a]) return false;
+        continue;
+      }
+      double t_0 = (low[a] - origin[a])/direction[a];
+      double t_1 = (high[a] - origin[a])/direction[a];
+      t_in = std::max(t_in, std::min(t_0, t_1));
+      t_out = std::min(t_out, std::max(t_0, t_1));
+    }
+    return (t_in < t_out);
+  }
+  
+  void VoxelModelXray::RayMaterialLengths(double o_x, double o_y, double o_z,
+      double d_x, double d_y, double d_z, double *lengths)
+  {
+    const double infinity = std::numeric_limits<double>::infinity();
+    double ray_length = sqrt(d_x*d_x + d_y*d_y + d_z*d_z);
+    if(background_material >= 0) lengths[background_material] += ray_length;
+    if(size_x == 0 || ray_length == 0.0) return;
+    
+    double origin[3] = {o_x, o_y, o_z};
+    double direction[3] = {d_x, d_y, d_z};
+    double low[3] = {lower.x, lower.y, lower.z};
+    double t_in, t_out;
+    if(!VolumeRange(origin, direction, t_in, t_out)) return;
+    if(background_material >= 0)
+    {
+      lengths[background_material] -= (t_out - t_in)*ray_length;
+    }
+    
+    // First voxel, step direction, parameter of the next boundary crossing
+    // and parameter distance between crossings along each axis
+    double size[3] = {voxel.x, voxel.y, voxel.z};
+    int count[3] = {size_x, size_y, size_z};
+    int index[3], step[3];
+    double t_next[3], t_delta[3];
+    for(int a = 0; a < 3; a++)
+    {
+      double p = origin[a] + t_in*direction[a];
+      index[a] = std::min(std::max(int(floor((p - low[a])/size[a])), 0),
+          count[a] - 1);
+      if(direction[a] > 0.0)
+      {
+        step[a] = 1;
+        t_next[a] = (low[a] + (index[a] + 1)*size[a] - origin[a])/direction[a];
+        t_delta[a] = size[a]/direction[a];
+      }
+      else if(direction[a] < 0.0)
+      {
+        step[a] = -1;
+        t_next[a] = (low[a] + index[a]*size[a] - origin[a])/direction[a];
+        t_delta[a] = -size[a]/direction[a];
+      }
+      else
+      {
+        step[a] = 0;
+        t_next[a] = infinity;
+        t_delta[a] = infinity;
+      }
+    }
+    
+    // Walk through the voxels
+    const unsigned char *labels = &voxel_labels[0];
+    const float *density = voxel_density.empty() ? 0 : &voxel_density[0];
+    const int *materials = &label_material[0];
+    double t = t_in;
+    while(true)
+    {
+      int a = (t_next[0] < t_next[1]) ? ((t_next[0] < t_next[2]) ? 0 : 2) :
+          ((t_next[1] < t_next[2]) ? 1 : 2);
+      double t_exit = std::min(t_next[a], t_out);
+      int v = BrickedIndex(index[0], index[1], index[2]);
+      int m = materials[(labels[v])];
+      if(m >= 0)
+      {
+        double length = (t_exit - t)*ray_length;
+        lengths[m] += (density != 0) ? length*density[v] : length;
+      }
+      if(t_next[a] >= t_out) break;
+      t = t_exit;
+      index[a] += step[a];
+      if(index[a] < 0 || index[a] >= count[a]) break;
+      t_next[a] += t_delta[a];
+    }
+  }
+  
+  void VoxelModelXray::RayLists(double o_x, double o_y, double o_z,
+      double d_x, double d_y, double d_z, XrayRayScratch &scratch)
+  {
+    // Material lengths, then the list of materials the ray actually crosses
+    int num_materials = MuData.size();
+    std::vector<double> &lengths = scratch.lengths;
+    lengths.assign(num_materials, 0.0);
+    RayMaterialLengths(o_x, o_y, o_z, d_x, d_y, d_z, &lengths[0]);
+    std::vector<double> &pathlengths = scratch.pathlengths;
+    std::vector<int> &ray_materials = scratch.ray_materials;
+    pathlengths.clear();
+    ray_materials.clear();
+    for(int m = 0; m < num_materials; m++)
+    {
+      if(lengths[m] <= 1.0e-6) continue;
+      pathlengths.push_back(lengths[m]);
+      ray_materials.push_back(m);
+    }
+  }
+  
+  double VoxelModelXray::RayAttenuation(double o_x, double o_y, double o_z,
+      double d_x, double d_y, double d_z, const std::vector<double> &spectrum,
+      XrayRayScratch &scratch)
+  {
+    RayLists(o_x, o_y, o_z, d_x, d_y, d_z, scratch);
+    return SpectrumAttenuation(scratch.pathlengths, scratch.ray_materials,
+        spectrum, scratch);
+  }
+  
+  double VoxelModelXray::GetRayAttenuation(Ray3 ray,
+      const std::vector<double> &spectrum, XrayRayScratch &scratch)
+  {
+    return RayAttenuation(ray.origin.x, ray.origin.y, ray.origin.z,
+        ray.direction.x, ray.direction.y, ray.direction.z,
+        MatchTabulatedSpectrum(spectrum), scratch);
+  }
+  
+  void VoxelModelXray::GetRayAttenuations(const RayBatch &rays,
+      const std::vector<double> &spectrum, double *attenuations,
+      XrayRayScratch &scratch, const double *air_attenuations)
+  {
+    const std::vector<double> &source = MatchTabulatedSpectrum(spectrum);
+    for(int r = 0; r < rays.Size(); r++)
+    {
+      // Rays that miss the volume's bounds only cross the background
+      if(air_attenuations != nullptr)
+      {
+        double origin[3] = {rays.origin_x[r], rays.origin_y[r],
+            rays.origin_z[r]};
+        double direction[3] = {rays.direction_x[r], rays.direction_y[r],
+            rays.direction_z[r]};
+        double t_in, t_out;
+        if(size_x == 0 || !VolumeRange(origin, direction, t_in, t_out))
+        {
+          attenuations[r] = air_attenuations[r];
+          continue;
+        }
+      }
+      attenuations[r] = RayAttenuation(rays.origin_x[r], rays.origin_y[r],
+          rays.origin_z[r], rays.direction_x[r], rays.direction_y[r],
+          rays.direction_z[r], source, scratch);
+    }
+  }
+  
+  void VoxelModelXray::TraceRays(const RayBatch &rays, RayPathCache &cache,
+      XrayRayScratch &scratch)
+  {
+    for(int r = 0; r < rays.Size(); r++)
+    {
+      RayLists(rays.origin_x[r], rays.origin_y[r], rays.origin_z[r],
+          rays.direction_x[r], rays.direction_y[r], rays.direction_z[r],
+          scratch);
+      cache.AddRay(scratch.pathlengths, scratch.ray_materials);
+    }
+  }
+}
@@ -0,0 +1,118 @@
+/******************************************************************************/
+/*                                                                            */
+/* Copyright 2016-2017 Steven Dolly                                           */
+/*                                                                            */
+/* Licensed under the Apache License, Version 2.0 (the "License");            */
+/* you may not use this file except in compliance with the License.           */
+/* You may obtain a copy of the License at:                                   */
+/*                                                                            */
+/*     http://www.apache.org/licenses/LICENSE-2.0                             */
+/*                                                                            */
+/* Unless required by applicable law or agreed to in writing, software        */
+/* distributed under the License is distributed on an "AS IS" BASIS,          */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   */
+/* See the License for the specific language governing permissions and        */
+/* limitations under the License.                                             */
+/*                                                                            */
+/******************************************************************************/
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// VoxelModelXray.hpp                                                         //
+// Voxelized X-ray Object Model Class Header File                             //
+// Created October 15, 2026                                                   //
+//                                                                            //
+// This header file contains the class for a voxelized phantom (a labeled or  //
+// Hounsfield unit volume) with x-ray attenuation data. It is derived from    //
+// ObjectModelXray, so it can be used by RayCT in place of an analytic        //
+// object model, and rays are traced through it with Siddon's method.         //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// Header guard
+#ifndef VOXELMODELXRAY_HPP
+#define VOXELMODELXRAY_HPP
+
+// C++ headers
+#include <string>
+#include <vector>
+
+// Custom headers
+#include "Geometry/Vec3.hpp"
+#include "Imaging/ObjectModelXray.hpp"
+
+namespace solutio
+{
+  class VoxelModelXray : public ObjectModelXray
+  {
+    public:
+      VoxelModelXray();
+      // Volume of nx x ny x nz voxels (x fastest) of the given size, with its
+      // lowest corner at corner; labels select the material of each voxel
+      bool SetVolume(int nx, int ny, int nz, Vec3<double> voxel_size,
+          Vec3<double> corner, const std::vector<unsigned char> &labels);
+      // Material for a label (labels without a material are vacuum)
+      bool AssignLabel(int label, std::string material);
+      // Optional density of each voxel relative to its label's material
+      bool SetDensityScale(const std::vector<float> &scale);
+      // Volume from Hounsfield units: voxels with thresholds[k] <= HU <
+      // thresholds[k + 1] get materials[k] (HU below thresholds[0] is
+      // vacuum), with density 1 + HU/1000 g/cm^3
+      bool SetHounsfieldVolume(int nx, int ny, int nz, Vec3<double> voxel_size,
+          Vec3<double> corner, const std::vector<short> &hu,
+          const std::vector<double> &thresholds,
+          const std::vector<std::string> &materials);
+      // Material outside the volume, along the rest of each source-detector
+      // ray (none by default)
+      bool SetBackgroundMaterial(std::string material);
+      // Path lengths (scaled by relative density) through each material for
+      // the ray from origin to origin + direction
+      void RayMaterialLengths(double o_x, double o_y, double o_z, double d_x,
+          double d_y, double d_z, double *lengths);
+      // Ray attenuation through the volume
+      using ObjectModelXray::GetRayAttenuation;
+      using ObjectModelXray::GetRayAttenuations;
+      double GetRayAttenuation(Ray3 ray, const std::vector<double> &spectrum,
+          XrayRayScratch &scratch);
+      void GetRayAttenuations(const RayBatch &rays,
+          const std::vector<double> &spectrum, double *attenuations,
+          XrayRayScratch &scratch, const double *air_attenuations = nullptr);
+      // Material path lengths of the rays for the two-phase evaluation
+      using ObjectModelXray::TraceRays;
+      void TraceRays(const RayBatch &rays, RayPathCache &cache,
+          XrayRayScratch &scratch);
+    protected:
+      int WorldMaterial(){ return background_material; }
+    private:
+      // Voxel position in the bricked arrays
+      int BrickedIndex(int i, int j, int k)
+      {
+        return ((((k >> 3)*bricks_y + (j >> 3))*bricks_x + (i >> 3)) << 9) +
+            ((k & 7) << 6) + ((j & 7) << 3) + (i & 7);
+      }
+      // Parametric range (within 0 <= t <= 1) of the ray inside the volume;
+      // false if the ray misses it
+      bool VolumeRange(const double *origin, const double *direction,
+          double &t_in, double &t_out);
+      // Lists of the materials crossed and their path lengths
+      void RayLists(double o_x, double o_y, double o_z, double d_x,
+          double d_y, double d_z, XrayRayScratch &scratch);
+      double RayAttenuation(double o_x, double o_y, double o_z, double d_x,
+          double d_y, double d_z, const std::vector<double> &spectrum,
+          XrayRayScratch &scratch);
+      // Volume dimensions
+      int size_x, size_y, size_z;
+      int bricks_x, bricks_y, bricks_z;
+      Vec3<double> voxel, lower, upper;
+      // Labels and relative densities, in 8 x 8 x 8 bricks so that the
+      // voxels a ray visits next share cache lines in every direction
+      std::vector<unsigned char> voxel_labels;
+      std::vector<float> voxel_density;
+      // Material of each label (-1 = vacuum) and outside the volume
+      std::vector<int> label_material;
+      int background_material;
+  };
+}
+
+// End header guard
+#endif
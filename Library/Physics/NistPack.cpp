@@ -0,0 +1,373 @@
+/******************************************************************************/
+/*                                                                            */
+/* Copyright 2016-2017 Steven Dolly                                           */
+/*                                                                            */
+/* Licensed under the Apache License, Version 2.0 (the "License");            */
+/* you may not use this file except in compliance with the License.           */
+/* You may obtain a copy of the License at:                                   */
+/*                                                                            */
+/*     http://www.apache.org/licenses/LICENSE-2.0                             */
+/*                                                                            */
+/* Unless required by applicable law or agreed to in writing, software        */
+/* distributed under the License is distributed on an "AS IS" BASIS,          */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   */
+/* See the License for the specific language governing permissions and        */
+/* limitations under the License.                                             */
+/*                                                                            */
+/******************************************************************************/
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// NistPack.cpp                                                               //
+// Packed NIST Photon Attenuation Database                                    //
+// Created October 15, 2026                                                   //
+//                                                                            //
+// This is the main file for the packed binary form of the NISTX data         //
+// folder, with functions to write a packed file and to map one for use by    //
+// the NistRegistry (see NistPack.hpp for the file layout).                   //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// Class header
+#include "Physics/NistPack.hpp"
+
+// Standard C headers
+#include <cstring>
+#include <stdint.h>
+
+// Standard C++ headers
+#include <iostream>
+#include <fstream>
+
+// System headers for memory mapping
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace solutio
+{
+  // Packed file structures
+  const char kNistPackMagic[8] = {'S','O','L','N','I','S','T','X'};
+  const uint32_t kNistPackEndianCheck = 0x01020304;
+  
+  struct NistPackHeader
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t endian_check;
+    uint32_t num_materials;
+    uint32_t entry_size;
+    uint64_t directory_offset;
+    uint64_t file_size;
+  };
+  
+  struct NistPackEntry
+  {
+    uint64_t names_offset;
+    uint32_t num_names; // Material name, then names to load it by
+    int32_t atomic_number;
+    double z_to_a_ratio;
+    double mean_exitation_energy;
+    double density;
+    uint64_t composition_offset;
+    uint32_t num_components;
+    uint32_t is_element;
+    uint64_t tables_offset; // Energies, log10 energies, mu/rho, mu_en/rho
+    uint32_t num_energies;
+    uint32_t num_edges;
+    uint64_t edges_offset;
+  };
+  
+  struct NistPackComponent
+  {
+    int32_t atomic_number;
+    int32_t padding;
+    double weight_fraction;
+  };
+  
+  // Append data to a packed file buffer, starting on an 8-byte boundary
+  uint64_t AppendPacked(std::vector<char> &buffer, const void *data,
+      size_t length)
+  {
+    buffer.resize((buffer.size() + 7) & ~size_t(7), 0);
+    uint64_t offset = buffer.size();
+    if(length > 0)
+    {
+      buffer.resize(buffer.size() + length);
+      memcpy(&buffer[offset], data, length);
+    }
+    return offset;
+  }
+  
+  bool PackNistDatabase(std::string folder, std::string packed_file)
+  {
+    std::vector<NistFolderEntry> entries = ListNistFolder(folder);
+    if(entries.empty())
+    {
+      std::cout << "Error: no NISTX data found in \"" << folder << "\"!\n";
+      return false;
+    }
+    
+    // Materials whose files cannot be read are left out of the packed file
+    std::vector<char> buffer(sizeof(NistPackHeader), 0);
+    std::vector<NistPackEntry> directory;
+    for(int n = 0; n < entries.size(); n++)
+    {
+      NistMaterial material;
+      if(!ReadNistxFile(folder + "/" + entries[n].file_name, material))
+      {
+        std::cout << "Warning: \"" << entries[n].names[0] << "\" was not " <<
+            "packed.\n";
+        continue;
+      }
+      directory.push_back(NistPackEntry());
+      NistPackEntry &entry = directory.back();
+      memset(&entry, 0, sizeof(NistPackEntry));
+      
+      std::string names = material.name + '\0';
+      for(int m = 0; m < entries[n].names.size(); m++)
+      {
+        names += entries[n].names[m] + '\0';
+      }
+      entry.names_offset = AppendPacked(buffer, names.data(), names.size());
+      entry.num_names = entries[n].names.size()+1;
+      entry.atomic_number = entries[n].atomic_number;
+      entry.z_to_a_ratio = material.z_to_a_ratio;
+      entry.mean_exitation_energy = material.mean_exitation_energy;
+      entry.density = material.density;
+      
+      std::vector<NistPackComponent> composition(
+          material.atomic_composition.size());
+      for(int m = 0; m < composition.size(); m++)
+      {
+        composition[m].atomic_number = material.atomic_composition[m].first;
+        composition[m].padding = 0;
+        composition[m].weight_fraction = material.atomic_composition[m].second;
+      }
+      entry.composition_offset = AppendPacked(buffer,
+          composition.empty() ? 0 : &composition[0],
+          composition.size()*sizeof(NistPackComponent));
+      entry.num_components = composition.size();
+      entry.is_element = material.is_element;
+      
+      entry.tables_offset = AppendPacked(buffer,
+          material.table_storage.empty() ? 0 : &material.table_storage[0],
+          material.table_storage.size()*sizeof(double));
+      entry.num_energies = material.energies.size;
+      
+      std::vector<int32_t> edges(material.edge_storage.begin(),
+          material.edge_storage.end());
+      entry.edges_offset = AppendPacked(buffer, edges.empty() ? 0 : &edges[0],
+          edges.size()*sizeof(int32_t));
+      entry.num_edges = edges.size();
+    }
+    
+    NistPackHeader header;
+    memset(&header, 0, sizeof(NistPackHeader));
+    memcpy(header.magic, kNistPackMagic, 8);
+    header.version = kNistPackVersion;
+    header.endian_check = kNistPackEndianCheck;
+    header.num_materials = directory.size();
+    header.entry_size = sizeof(NistPackEntry);
+    header.directory_offset = AppendPacked(buffer, directory.data(),
+        directory.size()*sizeof(NistPackEntry));
+    header.file_size = buffer.size();
+    memcpy(&buffer[0], &header, sizeof(NistPackHeader));
+    
+    std::ofstream fout(packed_file.c_str(), std::ios::binary);
+    fout.write(&buffer[0], buffer.size());
+    fout.close();
+    if(!fout)
+    {
+      std::cout << "Error: could not write packed NISTX file \"" <<
+          packed_file << "\"!\n";
+      return false;
+    }
+    return true;
+  }
+  
+  PackedNistDatabase::PackedNistDatabase()
+  {
+    data = 0;
+    data_size = 0;
+    num_materials = 0;
+    directory = 0;
+    mapping = 0;
+  }
+  
+  PackedNistDatabase::~PackedNistDatabase()
+  {
+    Close();
+  }
+  
+  bool PackedNistDatabase::Open(std::string file_path)
+  {
+    Close();
+    file_name = file_path;
+#ifndef _WIN32
+    int fd = open(file_path.c_str(), O_RDONLY);
+    struct stat file_stat;
+    if(fd >= 0 && fstat(fd, &file_stat) == 0 && file_stat.st_size > 0)
+    {
+      data_size = file_stat.st_size;
+      mapping = mmap(0, data_size, PROT_READ, MAP_SHARED, fd, 0);
+      if(mapping == MAP_FAILED) mapping = 0;
+    }
+    if(fd >= 0) close(fd);
+    if(mapping) data = (const char *)mapping;
+#else
+    std::ifstream fin(file_path.c_str(), std::ios::binary);
+    if(fin)
+    {
+      fin.seekg(0, std::ios::end);
+      buffer.resize(fin.tellg());
+      fin.seekg(0, std::ios::beg);
+      if(buffer.size() > 0) fin.read(&buffer[0], buffer.size());
+      if(fin && buffer.size() > 0)
+      {
+        data = &buffer[0];
+        data_size = buffer.size();
+      }
+    }
+#endif
+    if(!data)
+    {
+      std::cout << "Error: could not open packed NISTX file \"" << file_path <<
+          "\"!\n";
+      Close();
+      return false;
+    }
+    
+    // Check the header before using any offsets
+    NistPackHeader header;
+    bool valid = (data_size >= sizeof(NistPackHeader));
+    if(valid)
+    {
+      memcpy(&header, data, sizeof(NistPackHeader));
+      valid = (memcmp(header.magic, kNistPackMagic, 8) == 0 &&
+          header.endian_check == kNistPackEndianCheck &&
+          header.entry_size == sizeof(NistPackEntry) &&
+          header.file_size == data_size &&
+          InFile(header.directory_offset,
+          (unsigned long long)header.num_materials*sizeof(NistPackEntry)));
+    }
+    if(!valid)
+    {
+      std::cout << "Error: \"" << file_path << "\" is not a valid packed " <<
+          "NISTX file!\n";
+      Close();
+      return false;
+    }
+    if(header.version != kNistPackVersion)
+    {
+      std::cout << "Error: packed NISTX file \"" << file_path << "\" has " <<
+          "version " << header.version << " (expected " << kNistPackVersion <<
+          ")!\n";
+      Close();
+      return false;
+    }
+    num_materials = header.num_materials;
+    directory = data + header.directory_offset;
+    return true;
+  }
+  
+  void PackedNistDatabase::Close()
+  {
+#ifndef _WIN32
+    if(mapping) munmap(mapping, data_size);
+#endif
+    mapping = 0;
+    buffer.clear();
+    data = 0;
+    data_size = 0;
+    num_materials = 0;
+    directory = 0;
+  }
+  
+  bool PackedNistDatabase::InFile(unsigned long long offset,
+      unsigned long long length)
+  {
+    return (offset <= data_size && length <= (data_size - offset));
+  }
+  
+  NistFolderEntry PackedNistDatabase::GetEntry(int n)
+  {
+    NistFolderEntry folder_entry;
+    folder_entry.atomic_number = 0;
+    if(n < 0 || n >= num_materials) return folder_entry;
+    NistPackEntry entry;
+    memcpy(&entry, directory + n*sizeof(NistPackEntry), sizeof(NistPackEntry));
+    if(!InFile(entry.names_offset, 1))
+    {
+      std::cout << "Error: corrupt entry in packed NISTX file \"" <<
+          file_name << "\"!\n";
+      return folder_entry;
+    }
+    folder_entry.atomic_number = entry.atomic_number;
+    
+    // Skip the material name; the rest are names to load it by
+    const char *name = data + entry.names_offset;
+    const char *end = data + data_size;
+    for(int m = 0; m < entry.num_names && name < end; m++)
+    {
+      size_t length = strnlen(name, end - name);
+      if(m > 0) folder_entry.names.push_back(std::string(name, length));
+      name += length+1;
+    }
+    return folder_entry;
+  }
+  
+  std::shared_ptr<const NistMaterial> PackedNistDatabase::GetMaterial(int n)
+  {
+    std::shared_ptr<NistMaterial> material;
+    if(n < 0 || n >= num_materials) return material;
+    NistPackEntry entry;
+    memcpy(&entry, directory + n*sizeof(NistPackEntry), sizeof(NistPackEntry));
+    if(!InFile(entry.names_offset, 1) ||
+        !InFile(entry.composition_offset,
+        (unsigned long long)entry.num_components*sizeof(NistPackComponent)) ||
+        !InFile(entry.tables_offset,
+        4ULL*entry.num_energies*sizeof(double)) ||
+        !InFile(entry.edges_offset,
+        (unsigned long long)entry.num_edges*sizeof(int32_t)))
+    {
+      std::cout << "Error: corrupt entry in packed NISTX file \"" <<
+          file_name << "\"!\n";
+      return material;
+    }
+    
+    material.reset(new NistMaterial);
+    const char *name = data + entry.names_offset;
+    material->name = std::string(name,
+        strnlen(name, data_size - entry.names_offset));
+    material->is_element = entry.is_element;
+    material->z_to_a_ratio = entry.z_to_a_ratio;
+    material->mean_exitation_energy = entry.mean_exitation_energy;
+    material->density = entry.density;
+    const NistPackComponent *composition =
+        (const NistPackComponent *)(data + entry.composition_offset);
+    for(int m = 0; m < entry.num_components; m++)
+    {
+      material->atomic_composition.push_back(std::make_pair(
+          int(composition[m].atomic_number), composition[m].weight_fraction));
+    }
+    
+    // Tables are used in place
+    int num_energies = entry.num_energies;
+    const double *tables = (const double *)(data + entry.tables_offset);
+    material->energies = DataView<double>(tables, num_energies);
+    material->log_energies = DataView<double>(tables + num_energies,
+        num_energies);
+    material->mass_attenuation = DataView<double>(tables + 2*num_energies,
+        num_energies);
+    material->mass_energy_absorption = DataView<double>(
+        tables + 3*num_energies, num_energies);
+    material->absorption_edges = DataView<int>(
+        (const int *)(data + entry.edges_offset), entry.num_edges);
+    material->mapping = shared_from_this();
+    return material;
+  }
+}
@@ -0,0 +1,98 @@
+/******************************************************************************/
+/*                                                                            */
+/* Copyright 2016-2017 Steven Dolly                                           */
+/*                                                                            */
+/* Licensed under the Apache License, Version 2.0 (the "License");            */
+/* you may not use this file except in compliance with the License.           */
+/* You may obtain a copy of the License at:                                   */
+/*                                                                            */
+/*     http://www.apache.org/licenses/LICENSE-2.0                             */
+/*                                                                            */
+/* Unless required by applicable law or agreed to in writing, software        */
+/* distributed under the License is distributed on an "AS IS" BASIS,          */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   */
+/* See the License for the specific language governing permissions and        */
+/* limitations under the License.                                             */
+/*                                                                            */
+/******************************************************************************/
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// NistPack.hpp                                                               //
+// Packed NIST Photon Attenuation Database                                    //
+// Created October 15, 2026                                                   //
+//                                                                            //
+// This file contains the header for the packed binary form of the NISTX      //
+// data folder. All elements and compounds are stored in one versioned file   //
+// whose tables can be used in place (memory-mapped), so loading materials    //
+// requires no text parsing or copying of data.                               //
+//                                                                            //
+// File layout (host byte order, checked on load; 8-byte aligned blocks):     //
+//   header    : magic "SOLNISTX", version, endian check, material count,     //
+//               directory entry size, directory offset, file size            //
+//   materials : names (null-terminated strings), composition (Z, weight),    //
+//               tables (energies, log10 energies, mu/rho, mu_en/rho), and    //
+//               absorption edge indices, for each material                   //
+//   directory : one fixed-size entry per material, with the offsets above    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// Header guard
+#ifndef NISTPACK_HPP
+#define NISTPACK_HPP
+
+// Standard C++ headers
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Solutio C++ headers
+#include "Physics/NistPad.hpp"
+#include "Physics/NistRegistry.hpp"
+
+namespace solutio
+{
+  // Current version of the packed file format
+  const unsigned int kNistPackVersion = 1;
+  
+  // Pack all materials of a NISTX data folder into one binary file (returns
+  // true if successful)
+  bool PackNistDatabase(std::string folder, std::string packed_file);
+  
+  // Read-only packed NISTX database. The file is memory-mapped, and the
+  // materials it hands out view the mapped tables directly (keeping the
+  // database open for as long as they are in use).
+  class PackedNistDatabase :
+      public std::enable_shared_from_this<PackedNistDatabase>
+  {
+    public:
+      PackedNistDatabase();
+      ~PackedNistDatabase();
+      // Map and validate a packed file (returns true if successful)
+      bool Open(std::string file_path);
+      void Close();
+      int GetNumMaterials(){ return num_materials; }
+      // Names and atomic number of a material (no names for an invalid
+      // index or a corrupt entry)
+      NistFolderEntry GetEntry(int n);
+      // Material data; the database must be owned by a shared_ptr
+      std::shared_ptr<const NistMaterial> GetMaterial(int n);
+    private:
+      PackedNistDatabase(const PackedNistDatabase &);
+      void operator=(const PackedNistDatabase &);
+      bool InFile(unsigned long long offset, unsigned long long length);
+      
+      std::string file_name;
+      const char *data;
+      size_t data_size;
+      int num_materials;
+      const char *directory;
+      // Mapped data, or a copy of the file where mapping is not available
+      void *mapping;
+      std::vector<char> buffer;
+  };
+}
+
+// End header guard
+#endif
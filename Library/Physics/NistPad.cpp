@@ -32,51 +32,23 @@
 #include "Physics/NistPad.hpp"
 
 // Standard C headers
+#include <cmath>
 #include <cstdlib>
 
 // Standard C++ headers
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 
 // Solutio C++ headers
+#include "Physics/NistRegistry.hpp"
 #include "Utilities/DataInterpolation.hpp"
 
 namespace solutio
 {
-  // Default constructor
-  NistPad::NistPad()
-  {
-    
-  }
-
-  // Default destructor
-  NistPad::~NistPad()
-  {
-    
-  }
-  
-  NistPad::NistPad(std::string folder)
-  {
-    data_folder = folder;
-  }
-  
-  // Constructor that automatically loads element data based on atomic number
-  NistPad::NistPad(std::string folder, int atomic_number)
-  {
-    data_folder = folder;
-    Load(atomic_number);
-  }
-  
-  // Constructor that automatically loads element/compound data based on name 
-  NistPad::NistPad(std::string folder, std::string name)
-  {
-    data_folder = folder;
-    Load(name);
-  }
-
   // Data reading function
-  bool NistPad::ReadFile(std::string file_path)
+  bool ReadNistxFile(std::string file_path, NistMaterial &material)
   {
     std::ifstream fin;
     std::string line, str;
@@ -87,20 +59,26 @@ namespace solutio
     std::pair<int,double> entry;
     
     fin.open(file_path.c_str());
+    if(!fin.is_open())
+    {
+      std::cout << "Error: could not open NISTX file \"" << file_path <<
+          "\"!\n";
+      return false;
+    }
     
     // Read in material information from header
     for(int n = 0; n < 5; n++) std::getline(fin, line);
-    name = line;
+    material.name = line;
     
     for(int n = 0; n < 3; n++) std::getline(fin, line);
-    std::stringstream(line) >> z_to_a_ratio;
+    std::stringstream(line) >> material.z_to_a_ratio;
     
     for(int n = 0; n < 3; n++) std::getline(fin, line);
-    std::stringstream(line) >> mean_exitation_energy;
+    std::stringstream(line) >> material.mean_exitation_energy;
     
     for(int n = 0; n < 3; n++) std::getline(fin, line);
     line[5] = 'e';
-    std::stringstream(line) >> density;
+    std::stringstream(line) >> material.density;
     
     for(int n = 0; n < 2; n++) std::getline(fin, line);
     while(reading_elements)
@@ -117,21 +95,25 @@ namespace solutio
         entry.first = z;
         std::stringstream(line.substr(pos+1)) >> input;
         entry.second = input;
-        atomic_composition.push_back(entry);
+        material.atomic_composition.push_back(entry);
       }
     }
-    num_elements = atomic_composition.size();
-    if(num_elements == 1) is_element = true;
-    else is_element = false;
+    material.is_element = (material.atomic_composition.size() == 1);
     
     // Read in attenuation data
+    std::vector<double> energies, mass_attenuation, mass_energy_absorption;
     counter = 0;
     for(int n = 0; n < 3; n++) std::getline(fin, line);
     while(std::getline(fin, line))
     {
-      if(line[1] != '.') absorption_edges.push_back(counter);
+      // Skip blank lines; the table ends at the first line without data
+      if(line.find_first_not_of(" \t\r") == std::string::npos) continue;
+      pos = line.find('.');
+      if(pos == std::string::npos || pos == 0 || line.size() < (pos+29)) break;
       
-      pos = line.find('.'); pos--;
+      if(line[1] != '.') material.edge_storage.push_back(counter);
+      
+      pos--;
       line[(pos+7)] = line[(pos+18)] = line[(pos+29)] = 'e';
       
       str = line.substr(pos, 12);
@@ -151,101 +133,173 @@ namespace solutio
     
     fin.close();
     
-    return true;
-  }
-  
-  // Data loading function if element atomic number is given
-  bool NistPad::Load(int atomic_number)
-  {
-    std::ifstream fin;
-    std::string line;
-    
-    // Load element data file names
-    std::string element_list = data_folder + "/Elements/ElementList.txt";
-    std::vector<std::string> elements;
-    
-    fin.open(element_list.c_str());
-    while(std::getline(fin, line)){ elements.push_back(line); }
-    fin.close();
-    
-    ReadFile(data_folder + "/Elements/" + elements[(atomic_number-1)]);
+    // Store tables (and log10 of the energy grid, for interpolation) in one
+    // block of memory
+    std::vector<double> log_energies = Log10Table(MakeDataView(energies));
+    material.table_storage.reserve(4*counter);
+    material.table_storage.insert(material.table_storage.end(),
+        energies.begin(), energies.end());
+    material.table_storage.insert(material.table_storage.end(),
+        log_energies.begin(), log_energies.end());
+    material.table_storage.insert(material.table_storage.end(),
+        mass_attenuation.begin(), mass_attenuation.end());
+    material.table_storage.insert(material.table_storage.end(),
+        mass_energy_absorption.begin(), mass_energy_absorption.end());
+    const double *tables = material.table_storage.empty() ? 0 :
+        &material.table_storage[0];
+    material.energies = DataView<double>(tables, counter);
+    material.log_energies = DataView<double>(tables + counter, counter);
+    material.mass_attenuation = DataView<double>(tables + 2*counter, counter);
+    material.mass_energy_absorption = DataView<double>(tables + 3*counter,
+        counter);
+    material.absorption_edges = MakeDataView(material.edge_storage);
     
     return true;
   }
-
-  // Data loading function if element/compound name is given
-  bool NistPad::Load(std::string name)
+  
+  // Resample material data onto an energy grid of num_points nodes from
+  // e_min to e_max, spaced uniformly in energy or in log10(energy). Node
+  // values are calculated from the NIST data exactly as
+  // NistPad::MassAttenuation etc. would be; nodes at or below zero energy
+  // (uniform grids only) are set to zero.
+  bool MakeNistEnergyGrid(const NistMaterial &material, double e_min,
+      double e_max, int num_points, bool logarithmic, NistEnergyGrid &grid)
   {
-    std::ifstream fin;
-    std::string line;
-    bool found = false, element = false;
-    size_t p1, p2;
-    int id;
-    
-    // Load element data file names; search elements first
-    std::string element_list = data_folder + "/Elements/ElementList.txt";
-    std::vector<std::string> element_names, element_files;
-    fin.open(element_list.c_str());
-    while(std::getline(fin, line))
+    if(num_points < 2 || e_max <= e_min || (logarithmic && e_min <= 0.0))
     {
-      element_files.push_back(line);
-      p1 = line.find('-')+1;
-      p2 = line.find('.');
-      //std::cout << line.substr(p1, p2-p1) << '\n';
-      element_names.push_back(line.substr(p1, p2-p1));
+      std::cout << "Error: invalid energy grid for \"" << material.name <<
+          "\"!\n";
+      return false;
     }
-    fin.close();
-    for(int n = 0; n < element_names.size(); n++)
+    grid.logarithmic = logarithmic;
+    if(logarithmic)
     {
-      if(element_names[n] == name)
-      {
-        id = n;
-        found = true;
-        element = true;
-        break;
-      }
+      grid.start = log10(e_min);
+      grid.step = (log10(e_max) - grid.start) / (num_points-1);
     }
-    
-    // If not an element, search compounds
-    std::string compound_list = data_folder + "/Compounds/CompoundList.txt";
-    std::vector<std::string> compound_names, compound_files;
-    fin.open(compound_list.c_str());
-    while(std::getline(fin, line))
+    else
     {
-      p1 = line.find('\t');
-      compound_names.push_back(line.substr(0,p1));
-      compound_files.push_back(line.substr(p1+1));
+      grid.start = e_min;
+      grid.step = (e_max - e_min) / (num_points-1);
     }
-    fin.close();
-    for(int n = 0; n < compound_names.size(); n++)
+    
+    DataView<double> energies = material.energies;
+    DataView<double> log_energies = material.log_energies;
+    grid.energies.resize(num_points);
+    grid.mass_attenuation.resize(num_points);
+    grid.mass_energy_absorption.resize(num_points);
+    for(int n = 0; n < num_points; n++)
     {
-      if(compound_names[n] == name ||
-          compound_files[n].substr(0,compound_files[n].find('.')) == name)
+      double energy;
+      if(logarithmic) energy = pow(10.0, grid.start + n*grid.step);
+      else energy = grid.start + n*grid.step;
+      grid.energies[n] = energy;
+      if(energy <= 0.0)
       {
-        id = n;
-        found = true;
-        break;
+        grid.mass_attenuation[n] = 0.0;
+        grid.mass_energy_absorption[n] = 0.0;
+      }
+      else
+      {
+        grid.mass_attenuation[n] = LogInterpolationSearch(energies,
+            log_energies, material.mass_attenuation, energy);
+        grid.mass_energy_absorption[n] = LogInterpolationSearch(energies,
+            log_energies, material.mass_energy_absorption, energy);
       }
     }
     
-    if(found)
+    // Flag grid intervals that contain a NIST data point or end on an
+    // absorption edge; the grid alone cannot represent the data there. All
+    // other intervals lie within a single NIST interval, where log
+    // interpolation between grid nodes reproduces the NIST interpolation.
+    grid.data_intervals.assign(num_points, false);
+    for(int k = 0; k < energies.size; k++)
     {
-      if(element)
-      {
-        ReadFile(data_folder + "/Elements/" + element_files[id]);
-      }
-      else
+      int n = std::upper_bound(grid.energies.begin(), grid.energies.end(),
+          energies[k]) - grid.energies.begin();
+      if(n > 0 && n < num_points && energies[k] > grid.energies[(n-1)])
       {
-        ReadFile(data_folder + "/Compounds/" + compound_files[id]);
+        grid.data_intervals[(n-1)] = true;
       }
     }
-    else
+    for(int m = 0; m < material.absorption_edges.size; m++)
     {
-      std::cout << "Error: could not find specified element/material!\n";
-      std::cout << "Attempted search: " << data_folder << '\n';
+      int n = std::lower_bound(grid.energies.begin(), grid.energies.end(),
+          energies[(material.absorption_edges[m])]) - grid.energies.begin();
+      if(n > 0 && n < num_points) grid.data_intervals[(n-1)] = true;
     }
     
-    return found;
+    return true;
+  }
+  
+  // Default constructor
+  NistPad::NistPad()
+  {
+    
+  }
+
+  // Default destructor
+  NistPad::~NistPad()
+  {
+    
+  }
+  
+  NistPad::NistPad(std::string folder)
+  {
+    data_folder = folder;
+  }
+  
+  // Constructor that automatically loads element data based on atomic number
+  NistPad::NistPad(std::string folder, int atomic_number)
+  {
+    data_folder = folder;
+    Load(atomic_number);
+  }
+  
+  // Constructor that automatically loads element/compound data based on name 
+  NistPad::NistPad(std::string folder, std::string name)
+  {
+    data_folder = folder;
+    Load(name);
+  }
+  
+  // Use shared material data, resetting any name/density changes and grid
+  void NistPad::SetMaterial(std::shared_ptr<const NistMaterial> data)
+  {
+    material = data;
+    name = material->name;
+    density = material->density;
+    grid.reset();
+  }
+
+  // Data reading function
+  bool NistPad::ReadFile(std::string file_path)
+  {
+    std::shared_ptr<const NistMaterial> data =
+        NistRegistry::Instance().GetFile(file_path);
+    if(!data) return false;
+    SetMaterial(data);
+    return true;
+  }
+  
+  // Data loading function if element atomic number is given
+  bool NistPad::Load(int atomic_number)
+  {
+    std::shared_ptr<const NistMaterial> data =
+        NistRegistry::Instance().Get(data_folder, atomic_number);
+    if(!data) return false;
+    SetMaterial(data);
+    return true;
+  }
+
+  // Data loading function if element/compound name is given
+  bool NistPad::Load(std::string name)
+  {
+    std::shared_ptr<const NistMaterial> data =
+        NistRegistry::Instance().Get(data_folder, name);
+    if(!data) return false;
+    SetMaterial(data);
+    return true;
   }
   
   // Change material name if desired
@@ -269,37 +323,119 @@ namespace solutio
   // Get values from data using log interpolation
   double NistPad::MassAttenuation(double energy)
   {
-    return (LogInterpolation(energies, mass_attenuation, energy));
+    return (LogInterpolationSearch(material->energies,
+        material->log_energies, material->mass_attenuation, energy));
   }
   double NistPad::LinearAttenuation(double energy)
   {
-    return (density*LogInterpolation(energies, mass_attenuation, energy));
+    return (density*LogInterpolationSearch(material->energies,
+        material->log_energies, material->mass_attenuation, energy));
   }
   double NistPad::MassAbsorption(double energy)
   {
-    return (LogInterpolation(energies, mass_energy_absorption, energy));
+    return (LogInterpolationSearch(material->energies,
+        material->log_energies, material->mass_energy_absorption, energy));
   }
   double NistPad::LinearAbsorption(double energy)
   {
-    return (density*LogInterpolation(energies, mass_energy_absorption, energy));
+    return (density*LogInterpolationSearch(material->energies,
+        material->log_energies, material->mass_energy_absorption, energy));
+  }
+  
+  // Resample data onto an energy grid (see MakeNistEnergyGrid); grids are
+  // shared through the NistRegistry, so each one is only calculated once
+  void NistPad::TabulateEnergyGrid(double e_min, double e_max, int num_points,
+      bool logarithmic)
+  {
+    if(!material) return;
+    std::shared_ptr<const NistEnergyGrid> new_grid =
+        NistRegistry::Instance().GetEnergyGrid(material, e_min, e_max,
+        num_points, logarithmic);
+    if(new_grid) grid = new_grid;
+  }
+  
+  // Index of the grid node nearest to the given energy
+  int NistPad::GridIndex(double energy)
+  {
+    if(!grid) return 0;
+    double position;
+    if(grid->logarithmic) position = (log10(energy) - grid->start) / grid->step;
+    else position = (energy - grid->start) / grid->step;
+    int n = int(floor(position + 0.5));
+    if(n < 0) n = 0;
+    if(n >= grid->energies.size()) n = grid->energies.size()-1;
+    return n;
+  }
+  
+  // Interpolate grid values at any energy. Grid nodes are returned directly;
+  // between nodes the grid is log interpolated, except for flagged intervals,
+  // which use the original NIST data. Either way the result matches the
+  // NIST interpolation, including at absorption edges.
+  double NistPad::GridInterpolation(const std::vector<double> &grid_values,
+      DataView<double> data_values, double energy)
+  {
+    const std::vector<double> &grid_energies = grid->energies;
+    double position;
+    if(grid->logarithmic) position = (log10(energy) - grid->start) / grid->step;
+    else position = (energy - grid->start) / grid->step;
+    int n = int(floor(position));
+    if(n < 0) n = 0;
+    if(n >= (grid_energies.size()-1)) n = grid_energies.size()-2;
+    
+    if(energy == grid_energies[n]) return grid_values[n];
+    if(energy == grid_energies[(n+1)]) return grid_values[(n+1)];
+    if(grid->data_intervals[n] || grid_energies[n] <= 0.0)
+    {
+      return LogInterpolationSearch(material->energies,
+          material->log_energies, data_values, energy);
+    }
+    double f = (log10(energy) - log10(grid_energies[n])) /
+        (log10(grid_energies[(n+1)]) - log10(grid_energies[n]));
+    return (pow(grid_values[(n+1)], f) * pow(grid_values[n], (1-f)));
+  }
+  
+  double NistPad::MassAttenuationGrid(double energy)
+  {
+    if(!grid) return 0.0;
+    return GridInterpolation(grid->mass_attenuation,
+        material->mass_attenuation, energy);
+  }
+  double NistPad::LinearAttenuationGrid(double energy)
+  {
+    if(!grid) return 0.0;
+    return (density*GridInterpolation(grid->mass_attenuation,
+        material->mass_attenuation, energy));
+  }
+  double NistPad::MassAbsorptionGrid(double energy)
+  {
+    if(!grid) return 0.0;
+    return GridInterpolation(grid->mass_energy_absorption,
+        material->mass_energy_absorption, energy);
+  }
+  double NistPad::LinearAbsorptionGrid(double energy)
+  {
+    if(!grid) return 0.0;
+    return (density*GridInterpolation(grid->mass_energy_absorption,
+        material->mass_energy_absorption, energy));
   }
 
   // Print data to terminal screen
   void NistPad::PrintTable()
   {
-    for(int n = 0; n < energies.size(); n++)
+    const NistMaterial &data = *material;
+    for(int n = 0; n < data.energies.size; n++)
     {
-      std::cout << energies[n] << ' ' << mass_attenuation[n] << ' ' <<
-          mass_energy_absorption[n] << '\n';
+      std::cout << data.energies[n] << ' ' << data.mass_attenuation[n] << ' ' <<
+          data.mass_energy_absorption[n] << '\n';
     }
     std::cout << '\n';
-    if(absorption_edges.size() > 0)
+    if(data.absorption_edges.size > 0)
     {
-      for(int n = 0; n < absorption_edges.size(); n++)
+      for(int n = 0; n < data.absorption_edges.size; n++)
       {
-        std::cout << energies[(absorption_edges[n])] << ' ' <<
-            mass_attenuation[(absorption_edges[n])] << ' ' <<
-            mass_energy_absorption[(absorption_edges[n])] << '\n';
+        std::cout << data.energies[(data.absorption_edges[n])] << ' ' <<
+            data.mass_attenuation[(data.absorption_edges[n])] << ' ' <<
+            data.mass_energy_absorption[(data.absorption_edges[n])] << '\n';
       }
     }
   }
@@ -309,18 +445,19 @@ namespace solutio
   {
     std::cout << name << '\n';
     
-    if(is_element) std::cout << "This is an element.\n\n";
+    if(material->is_element) std::cout << "This is an element.\n\n";
     else  std::cout << "This is not an element.\n\n";
   
-    std::cout << "Z/A = " << z_to_a_ratio << '\n';
-    std::cout << "I (eV) = " << mean_exitation_energy << '\n';
+    std::cout << "Z/A = " << material->z_to_a_ratio << '\n';
+    std::cout << "I (eV) = " << material->mean_exitation_energy << '\n';
     std::cout << "Density (g/cm^3) = " << density << "\n\n";
     
     std::cout << "Elements by Weight\n";
     std::cout << "------------------\n";
-    for(int n = 0; n < num_elements; n++)
+    for(int n = 0; n < material->atomic_composition.size(); n++)
     {
-      std::cout << atomic_composition[n].first << " : " << atomic_composition[n].second << '\n';
+      std::cout << material->atomic_composition[n].first << " : " <<
+          material->atomic_composition[n].second << '\n';
     }
     std::cout << '\n';
   
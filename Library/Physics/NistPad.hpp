@@ -33,11 +33,62 @@
 #define NISTPAD_HPP
 
 // Standard C++ headers
+#include <memory>
 #include <string>
 #include <vector>
 
+// Solutio C++ headers
+#include "Utilities/DataInterpolation.hpp"
+
 namespace solutio
 {
+  // Photon attenuation data for one element/compound, as read from a NISTX
+  // file or a packed NISTX database. Loaded materials are shared (read-only)
+  // between NistPad objects.
+  struct NistMaterial
+  {
+    std::string name;
+    bool is_element;
+    std::vector< std::pair<int,double> > atomic_composition;
+    double z_to_a_ratio;
+    double mean_exitation_energy;
+    double density;
+    
+    // Data tables; these view either the storage below (text files) or a
+    // mapped packed database, so a NistMaterial must not be copied
+    DataView<double> energies;
+    DataView<double> log_energies;
+    DataView<double> mass_attenuation;
+    DataView<double> mass_energy_absorption;
+    
+    DataView<int> absorption_edges;
+    
+    // Table storage for data read from a text file
+    std::vector<double> table_storage;
+    std::vector<int> edge_storage;
+    // Keeps a packed database mapped while its data is in use
+    std::shared_ptr<const void> mapping;
+  };
+  
+  // Material data resampled onto a uniform or logarithmic energy grid
+  struct NistEnergyGrid
+  {
+    bool logarithmic;
+    double start;
+    double step;
+    std::vector<double> energies;
+    std::vector<double> mass_attenuation;
+    std::vector<double> mass_energy_absorption;
+    // Intervals that contain a NIST data point or end on an absorption edge
+    std::vector<bool> data_intervals;
+  };
+  
+  // Read a NISTX data file (returns true if successful)
+  bool ReadNistxFile(std::string file_path, NistMaterial &material);
+  // Resample material data onto an energy grid (returns true if successful)
+  bool MakeNistEnergyGrid(const NistMaterial &material, double e_min,
+      double e_max, int num_points, bool logarithmic, NistEnergyGrid &grid);
+  
   class NistPad
   {
     public:
@@ -52,11 +103,13 @@ namespace solutio
       NistPad(std::string folder, std::string name);
       // Get and set functions
       std::string get_name(){ return name; }
-      // File loading functions (returns true if successful)
+      // File loading functions (returns true if successful); data is shared
+      // through the NistRegistry, so each file is only read once
       bool SetDataFolder(std::string folder);
       bool ReadFile(std::string file_name);
       bool Load(int atomic_number);
       bool Load(std::string name);
+      bool IsLoaded(){ return (material.get() != 0); }
       // Material editing
       void Rename(std::string new_name);
       void ForceDensity(float new_density);
@@ -65,33 +118,61 @@ namespace solutio
       double LinearAttenuation(double energy);
       double MassAbsorption(double energy);
       double LinearAbsorption(double energy);
+      // Resample data onto a uniform or logarithmic energy grid, after which
+      // values at grid nodes are read directly from the tables (no grid is
+      // made if no data is loaded; grid values are then 0)
+      void TabulateEnergyGrid(double e_min, double e_max, int num_points,
+          bool logarithmic = false);
+      bool IsGridTabulated(){ return (grid.get() != 0); }
+      int GridSize(){ return grid ? grid->energies.size() : 0; }
+      double GridEnergy(int n){ return grid ? grid->energies[n] : 0.0; }
+      int GridIndex(double energy);
+      double GridMassAttenuation(int n)
+      {
+        return grid ? grid->mass_attenuation[n] : 0.0;
+      }
+      double GridLinearAttenuation(int n)
+      {
+        return grid ? density*grid->mass_attenuation[n] : 0.0;
+      }
+      double GridMassAbsorption(int n)
+      {
+        return grid ? grid->mass_energy_absorption[n] : 0.0;
+      }
+      double GridLinearAbsorption(int n)
+      {
+        return grid ? density*grid->mass_energy_absorption[n] : 0.0;
+      }
+      // Get values at any energy from the grid, with log interpolation
+      // between grid nodes
+      double MassAttenuationGrid(double energy);
+      double LinearAttenuationGrid(double energy);
+      double MassAbsorptionGrid(double energy);
+      double LinearAbsorptionGrid(double energy);
       // Get material values
-      double GetZtoA(){ return z_to_a_ratio; }
-      double GetI(){ return mean_exitation_energy; }
+      double GetZtoA(){ return material->z_to_a_ratio; }
+      double GetI(){ return material->mean_exitation_energy; }
       double GetDensity(){ return density; }
       std::vector< std::pair<int,double> > GetComposition()
       {
-        return atomic_composition;
+        return material->atomic_composition;
       }
+      std::shared_ptr<const NistMaterial> GetMaterialData(){ return material; }
       // Prints data to terminal screen
       void PrintTable();
       void PrintData();
     private:
+      void SetMaterial(std::shared_ptr<const NistMaterial> data);
+      double GridInterpolation(const std::vector<double> &grid_values,
+          DataView<double> data_values, double energy);
+      
       std::string data_folder;
       
+      // Material name and density may be changed from the shared data
       std::string name;
-      unsigned int num_elements;
-      bool is_element;
-      std::vector< std::pair<int,double> > atomic_composition;
-      double z_to_a_ratio;
-      double mean_exitation_energy;
       double density;
-      
-      std::vector<double> energies;
-      std::vector<double> mass_attenuation;
-      std::vector<double> mass_energy_absorption;
-      
-      std::vector<int> absorption_edges;
+      std::shared_ptr<const NistMaterial> material;
+      std::shared_ptr<const NistEnergyGrid> grid;
   };
 }
 
@@ -0,0 +1,266 @@
+/******************************************************************************/
+/*                                                                            */
+/* Copyright 2016-2017 Steven Dolly                                           */
+/*                                                                            */
+/* Licensed under the Apache License, Version 2.0 (the "License");            */
+/* you may not use this file except in compliance with the License.           */
+/* You may obtain a copy of the License at:                                   */
+/*                                                                            */
+/*     http://www.apache.org/licenses/LICENSE-2.0                             */
+/*                                                                            */
+/* Unless required by applicable law or agreed to in writing, software        */
+/* distributed under the License is distributed on an "AS IS" BASIS,          */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   */
+/* See the License for the specific language governing permissions and        */
+/* limitations under the License.                                             */
+/*                                                                            */
+/******************************************************************************/
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// NistRegistry.cpp                                                           //
+// NIST Material Registry Class                                               //
+// Created October 15, 2026                                                   //
+//                                                                            //
+// This is the main file for the process-wide registry of NIST photon         //
+// attenuation data. Each NISTX data folder is indexed once, and each         //
+// material file is read once; loaded materials (and their resampled energy   //
+// grids) are then shared, read-only, by every NistPad that uses them. A     //
+// packed NISTX database may be mapped in place of a data folder. All         //
+// functions are thread-safe.                                                 //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// Class header
+#include "Physics/NistRegistry.hpp"
+
+// Standard C++ headers
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+// Solutio C++ headers
+#include "Physics/NistPack.hpp"
+
+namespace solutio
+{
+  NistRegistry &NistRegistry::Instance()
+  {
+    static NistRegistry registry;
+    return registry;
+  }
+  
+  // Read the element and compound lists of a NISTX data folder
+  std::vector<NistFolderEntry> ListNistFolder(std::string folder)
+  {
+    std::vector<NistFolderEntry> entries;
+    std::ifstream fin;
+    std::string line;
+    size_t p1, p2;
+    
+    // Elements are listed by file name (e.g. "13-Aluminum.nistx"), in order
+    // of atomic number
+    std::string element_list = folder + "/Elements/ElementList.txt";
+    fin.open(element_list.c_str());
+    while(std::getline(fin, line))
+    {
+      NistFolderEntry entry;
+      entry.file_name = "Elements/" + line;
+      entry.atomic_number = entries.size()+1;
+      p1 = line.find('-')+1;
+      p2 = line.find('.');
+      entry.names.push_back(line.substr(p1, p2-p1));
+      entries.push_back(entry);
+    }
+    fin.close();
+    
+    // Compounds are listed by full name and file name; both may be used (e.g.
+    // "Water, Liquid" or "Water")
+    std::string compound_list = folder + "/Compounds/CompoundList.txt";
+    fin.open(compound_list.c_str());
+    while(std::getline(fin, line))
+    {
+      NistFolderEntry entry;
+      p1 = line.find('\t');
+      std::string file_name = line.substr(p1+1);
+      entry.file_name = "Compounds/" + file_name;
+      entry.atomic_number = 0;
+      entry.names.push_back(line.substr(0,p1));
+      entry.names.push_back(file_name.substr(0,file_name.find('.')));
+      entries.push_back(entry);
+    }
+    fin.close();
+    
+    return entries;
+  }
+  
+  // Add a material to a folder index; names already in use (e.g. element
+  // names) take precedence
+  void NistRegistry::AddIndexEntry(FolderIndex &index,
+      const NistFolderEntry &entry, std::string source)
+  {
+    if(entry.atomic_number > 0)
+    {
+      if(index.element_sources.size() < entry.atomic_number)
+      {
+        index.element_sources.resize(entry.atomic_number);
+      }
+      index.element_sources[(entry.atomic_number-1)] = source;
+    }
+    if(entry.names.size() > 0) index.material_names.push_back(entry.names[0]);
+    for(int n = 0; n < entry.names.size(); n++)
+    {
+      if(index.material_sources.count(entry.names[n]) == 0)
+      {
+        index.material_sources[entry.names[n]] = source;
+      }
+    }
+  }
+  
+  // Index the materials of a data folder (call with lock held); folders
+  // without data are not kept, so they are scanned again on the next call
+  const NistRegistry::FolderIndex &NistRegistry::IndexFolder(
+      std::string folder)
+  {
+    std::map<std::string, FolderIndex>::iterator it = folders.find(folder);
+    if(it != folders.end()) return it->second;
+    
+    FolderIndex index;
+    std::vector<NistFolderEntry> entries = ListNistFolder(folder);
+    for(int n = 0; n < entries.size(); n++)
+    {
+      AddIndexEntry(index, entries[n], folder + "/" + entries[n].file_name);
+    }
+    
+    if(index.material_names.empty())
+    {
+      std::cout << "Error: no NISTX data found in \"" << folder << "\"!\n";
+      static const FolderIndex empty_index;
+      return empty_index;
+    }
+    return (folders[folder] = index);
+  }
+  
+  // Read a material from its source, or reuse it if already read (call with
+  // lock held)
+  std::shared_ptr<const NistMaterial> NistRegistry::LoadFile(
+      std::string source)
+  {
+    std::map<std::string, std::shared_ptr<const NistMaterial> >::iterator it =
+        materials.find(source);
+    if(it != materials.end()) return it->second;
+    
+    std::shared_ptr<const NistMaterial> material;
+    if(packed_sources.count(source) > 0)
+    {
+      std::pair<std::shared_ptr<PackedNistDatabase>, int> &packed =
+          packed_sources[source];
+      material = packed.first->GetMaterial(packed.second);
+    }
+    else
+    {
+      std::shared_ptr<NistMaterial> new_material(new NistMaterial);
+      if(ReadNistxFile(source, *new_material)) material = new_material;
+    }
+    if(material) materials[source] = material;
+    return material;
+  }
+  
+  // Replace the index of a data folder with the contents of a packed
+  // database; materials are created directly on the mapped data when needed
+  bool NistRegistry::MapPackedDatabase(std::string folder,
+      std::string packed_file)
+  {
+    std::shared_ptr<PackedNistDatabase> database(new PackedNistDatabase);
+    if(!database->Open(packed_file)) return false;
+    
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    FolderIndex index;
+    for(int n = 0; n < database->GetNumMaterials(); n++)
+    {
+      std::stringstream source;
+      source << packed_file << '#' << n;
+      packed_sources[source.str()] = std::make_pair(database, n);
+      AddIndexEntry(index, database->GetEntry(n), source.str());
+    }
+    folders[folder] = index;
+    return true;
+  }
+  
+  std::shared_ptr<const NistMaterial> NistRegistry::Get(std::string folder,
+      int atomic_number)
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    const FolderIndex &index = IndexFolder(folder);
+    if(atomic_number < 1 || atomic_number > index.element_sources.size() ||
+        index.element_sources[(atomic_number-1)].empty())
+    {
+      std::cout << "Error: no data for element Z = " << atomic_number <<
+          "!\n";
+      return std::shared_ptr<const NistMaterial>();
+    }
+    return LoadFile(index.element_sources[(atomic_number-1)]);
+  }
+  
+  std::shared_ptr<const NistMaterial> NistRegistry::Get(std::string folder,
+      std::string name)
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    const FolderIndex &index = IndexFolder(folder);
+    std::map<std::string, std::string>::const_iterator it =
+        index.material_sources.find(name);
+    if(it == index.material_sources.end())
+    {
+      std::cout << "Error: could not find specified element/material!\n";
+      std::cout << "Attempted search: " << folder << '\n';
+      return std::shared_ptr<const NistMaterial>();
+    }
+    return LoadFile(it->second);
+  }
+  
+  std::shared_ptr<const NistMaterial> NistRegistry::GetFile(
+      std::string file_path)
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    return LoadFile(file_path);
+  }
+  
+  std::shared_ptr<const NistEnergyGrid> NistRegistry::GetEnergyGrid(
+      std::shared_ptr<const NistMaterial> material, double e_min, double e_max,
+      int num_points, bool logarithmic)
+  {
+    if(!material) return std::shared_ptr<const NistEnergyGrid>();
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    std::tuple<const NistMaterial *, double, double, int, bool> key(
+        material.get(), e_min, e_max, num_points, logarithmic);
+    GridMap::iterator it = grids.find(key);
+    if(it != grids.end()) return it->second.second;
+    
+    std::shared_ptr<NistEnergyGrid> grid(new NistEnergyGrid);
+    if(!MakeNistEnergyGrid(*material, e_min, e_max, num_points, logarithmic,
+        *grid))
+    {
+      return std::shared_ptr<const NistEnergyGrid>();
+    }
+    // The key holds the material's address, so the entry also holds on to the
+    // material to keep that address from being reused
+    grids[key] = std::make_pair(material,
+        std::shared_ptr<const NistEnergyGrid>(grid));
+    return grid;
+  }
+  
+  std::vector<std::string> NistRegistry::GetMaterialNames(std::string folder)
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    return IndexFolder(folder).material_names;
+  }
+  
+  void NistRegistry::Clear()
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    grids.clear();
+    materials.clear();
+    packed_sources.clear();
+    folders.clear();
+  }
+}
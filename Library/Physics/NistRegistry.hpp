@@ -0,0 +1,118 @@
+/******************************************************************************/
+/*                                                                            */
+/* Copyright 2016-2017 Steven Dolly                                           */
+/*                                                                            */
+/* Licensed under the Apache License, Version 2.0 (the "License");            */
+/* you may not use this file except in compliance with the License.           */
+/* You may obtain a copy of the License at:                                   */
+/*                                                                            */
+/*     http://www.apache.org/licenses/LICENSE-2.0                             */
+/*                                                                            */
+/* Unless required by applicable law or agreed to in writing, software        */
+/* distributed under the License is distributed on an "AS IS" BASIS,          */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   */
+/* See the License for the specific language governing permissions and        */
+/* limitations under the License.                                             */
+/*                                                                            */
+/******************************************************************************/
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// NistRegistry.hpp                                                           //
+// NIST Material Registry Class                                               //
+// Created October 15, 2026                                                   //
+//                                                                            //
+// This file contains the header for the process-wide registry of NIST photon //
+// attenuation data. Each NISTX data folder is indexed once, and each         //
+// material file is read once; loaded materials (and their resampled energy   //
+// grids) are then shared, read-only, by every NistPad that uses them. A     //
+// packed NISTX database may be mapped in place of a data folder. All         //
+// functions are thread-safe.                                                 //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// Header guard
+#ifndef NISTREGISTRY_HPP
+#define NISTREGISTRY_HPP
+
+// Standard C++ headers
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// Solutio C++ headers
+#include "Physics/NistPad.hpp"
+
+namespace solutio
+{
+  class PackedNistDatabase;
+  
+  // One element/compound listed in a NISTX data folder
+  struct NistFolderEntry
+  {
+    std::string file_name; // Relative to the folder
+    int atomic_number; // 0 for compounds
+    std::vector<std::string> names; // Names the material can be loaded by
+  };
+  
+  // Read the element and compound lists of a NISTX data folder
+  std::vector<NistFolderEntry> ListNistFolder(std::string folder);
+  
+  class NistRegistry
+  {
+    public:
+      // Registry shared by the whole process
+      static NistRegistry &Instance();
+      // Get material data by atomic number, by element/compound name, or by
+      // file (returns a null pointer if not found)
+      std::shared_ptr<const NistMaterial> Get(std::string folder,
+          int atomic_number);
+      std::shared_ptr<const NistMaterial> Get(std::string folder,
+          std::string name);
+      std::shared_ptr<const NistMaterial> GetFile(std::string file_path);
+      // Get material data resampled onto an energy grid
+      std::shared_ptr<const NistEnergyGrid> GetEnergyGrid(
+          std::shared_ptr<const NistMaterial> material, double e_min,
+          double e_max, int num_points, bool logarithmic);
+      // Names of all elements/compounds in a data folder
+      std::vector<std::string> GetMaterialNames(std::string folder);
+      // Serve a data folder from a packed NISTX database (see NistPack.hpp);
+      // returns true if the database was mapped successfully
+      bool MapPackedDatabase(std::string folder, std::string packed_file);
+      // Release all cached data (NistPads keep the data they already use)
+      void Clear();
+    private:
+      NistRegistry(){}
+      NistRegistry(const NistRegistry &);
+      void operator=(const NistRegistry &);
+      
+      // Data source of each material in a data folder; a source is either a
+      // file path or a key in packed_sources
+      struct FolderIndex
+      {
+        std::vector<std::string> element_sources;
+        std::vector<std::string> material_names;
+        std::map<std::string, std::string> material_sources;
+      };
+      void AddIndexEntry(FolderIndex &index, const NistFolderEntry &entry,
+          std::string source);
+      const FolderIndex &IndexFolder(std::string folder);
+      std::shared_ptr<const NistMaterial> LoadFile(std::string source);
+      
+      std::mutex registry_mutex;
+      std::map<std::string, FolderIndex> folders;
+      std::map<std::string, std::shared_ptr<const NistMaterial> > materials;
+      std::map<std::string, std::pair<std::shared_ptr<PackedNistDatabase>,
+          int> > packed_sources;
+      typedef std::map< std::tuple<const NistMaterial *, double, double, int,
+          bool>, std::pair< std::shared_ptr<const NistMaterial>,
+          std::shared_ptr<const NistEnergyGrid> > > GridMap;
+      GridMap grids;
+  };
+}
+
+// End header guard
+#endif
@@ -30,13 +30,18 @@
 
 #include "CBDose.hpp"
 
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 
 #include <iostream>
 #include <fstream>
 #include <sstream>
 
-#include "/home/steven/C++/SolutioCpp/Library/Utilities/DataInterpolation.hpp"
+#include "Utilities/DataInterpolation.hpp"
+#include "Utilities/ParallelFor.hpp"
 
 /////////////////////////////////////
 // Class to manage beam setup data //
@@ -55,13 +60,61 @@ void LinacBeam::SetFieldSize(float x1, float x2, float y1, float y2){
   Y2 = y2;
 }
 
+//////////////////////////////////////////////
+// Class to manage regularly gridded tables //
+//////////////////////////////////////////////
+
+UniformTable::UniformTable(){
+  x_0 = 0; x_scale = 0; x_size = 0;
+  y_0 = 0; y_scale = 0; y_size = 0;
+}
+
+// Bilinear interpolation on a regular grid. The cell index is clamped to the
+// grid (truncation equals floor once clamped at 0), so points outside it are
+// extrapolated from the edge cells; there are no branches, so loops calling
+// it can vectorize.
+static inline float GridInterpolation(const float *values, float x_0,
+    float x_scale, int x_size, float y_0, float y_scale, int y_size,
+    float x, float y){
+  float u = (x - x_0)*x_scale;
+  int i = std::min(std::max(int(u), 0), x_size - 2);
+  float f_x = u - i;
+  float v = (y - y_0)*y_scale;
+  int j = std::min(std::max(int(v), 0), y_size - 2);
+  float f_y = v - j;
+  int n_1 = i*y_size + j;
+  int n_2 = n_1 + y_size;
+  float y_1 = f_y*values[(n_1+1)] + (1-f_y)*values[n_1];
+  float y_2 = f_y*values[(n_2+1)] + (1-f_y)*values[n_2];
+  return (f_x*y_2 + (1-f_x)*y_1);
+}
+
+float UniformTable::Lookup(float x) const {
+  float u = (x - x_0)*x_scale;
+  int i = std::min(std::max(int(u), 0), x_size - 2);
+  float f = u - i;
+  return (f*values[(i+1)] + (1-f)*values[i]);
+}
+
+float UniformTable::Lookup(float x, float y) const {
+  return GridInterpolation(&values[0], x_0, x_scale, x_size, y_0, y_scale,
+      y_size, x, y);
+}
+
 ////////////////////////////////////////////
 // Class to manage calculation point data //
 ////////////////////////////////////////////
 
+CalcPoint::CalcPoint(){
+  depth = 0.0;
+  off_axis_distance = 0.0;
+  radiological_depth = 0.0;
+}
+
 void CalcPoint::SetPoint(float d, float doa){
   depth = d;
   off_axis_distance = doa;
+  radiological_depth = d;
 }
 
 ///////////////////////
@@ -70,9 +123,8 @@ void CalcPoint::SetPoint(float d, float doa){
 
 // Calculate equivalent square field sizes
 float SquareField(float a, float b){ return ( (2*a*b) / (a+b) ); }
-float SquareField(float r){
-  
-}
+// Square of the same area as a circular field of radius r
+float SquareField(float r){ return (r*sqrt(M_PI)); }
 
 // Mayneord F factor for PDD conversion to different SSD
 float MayneordF(float f_1, float f_2, float d_0, float d){
@@ -94,145 +146,273 @@ float AnalyticPenumbraModel(float oad, float field_size){
 
 CBDose::CBDose(){
   SAD = 100.0;
+  uniform_steps[0] = uniform_steps[1] = uniform_steps[2] = 0.0;
+  uniform_error = 0.0;
 }
 
-void CBDose::LoadData(std::string file_name){
-  // Initialization and open file
-  std::ifstream fin;
-  std::string input, str;
-  size_t p1, p2;
-  bool reading = true;
-  float temp;
-  
-  fin.open(file_name.c_str());
-  
-  // Get first line and display
-  std::getline(fin, input);
-  std::cout << input << '\n';
-  for(int n = 0; n < 3; n++){ std::getline(fin, input); }
-  
-  // Get calibration constant, SSD, and depth
-  std::getline(fin, input);
-  p1 = input.find(':'); p1++; p2 = input.find('c');
-  str = input.substr(p1,p2-p1);
-  std::stringstream(str) >> k;
-  
-  std::getline(fin, input);
-  p1 = input.find(':'); p1++; p2 = input.find('c');
-  str = input.substr(p1,p2-p1);
-  std::stringstream(str) >> d_0;
-  
-  std::getline(fin, input);
-  p1 = input.find(':'); p1++; p2 = input.find('c');
-  str = input.substr(p1,p2-p1);
-  std::stringstream(str) >> SSD_0;
-  
-  std::getline(fin, input);
-  p1 = input.find(':'); p1++; p2 = input.find('c');
-  str = input.substr(p1,p2-p1);
-  std::stringstream(str) >> SSD_PDD;
-  
-  std::cout << "Calibration constant (k) = " << k << " cGy/MU @ " << d_0 << " cm\n";
-  std::cout << "PDD measured using " << SSD_PDD << " cm SSD\n";
-  for(int n = 0; n < 4; n++){ std::getline(fin, input); }
-  
-  // Get scatter factor tables for S_c and S_p
-  int ind = 0;
-  while(reading){
-    std::getline(fin, input);
-    if(input == "end scatter factors"){
-      reading = false;
+// Reader for a beam data file held in memory, one line at a time. Lines are
+// returned without trailing whitespace, skipping blank lines and heading
+// underlines; errors are reported with the file name and line number.
+class BeamDataReader {
+  public:
+    BeamDataReader(const std::string &file_text, const std::string &file) :
+        text(file_text), file_name(file), position(0), line_number(0),
+        last_position(0), last_line_number(0) {}
+    bool NextLine(std::string &line);
+    // Return the last line read to the input
+    void Unread(){ position = last_position; line_number = last_line_number; }
+    bool Error(const std::string &message){
+      std::cout << "Error: \"" << file_name << "\", line " << line_number <<
+          ": " << message << "!\n";
+      return false;
     }
-    else {
-      p1 = input.find(' ');
-      std::stringstream(input.substr(0,p1)) >> temp;
-      r_scatter.push_back(temp);
-      
-      p2 = input.find(' ',p1+1);
-      std::stringstream(input.substr(p1,p2-p1)) >> temp;
-      S_c_data.push_back(temp);
-      
-      std::stringstream(input.substr(p2)) >> temp;
-      S_p_data.push_back(temp);
+  private:
+    const std::string &text;
+    std::string file_name;
+    size_t position;
+    int line_number;
+    size_t last_position;
+    int last_line_number;
+};
+
+bool BeamDataReader::NextLine(std::string &line){
+  last_position = position;
+  last_line_number = line_number;
+  while(position < text.size()){
+    size_t end = text.find('\n', position);
+    if(end == std::string::npos) end = text.size();
+    size_t first = position;
+    position = end + 1;
+    line_number++;
+    if(end == first) continue;
+    size_t last = text.find_last_not_of(" \t\r", end - 1);
+    if(last == std::string::npos || last < first) continue;
+    if(text.find_first_not_of('-', first) > last) continue;
+    line.assign(text, first, last - first + 1);
+    return true;
+  }
+  return false;
+}
+
+// All whitespace-separated numbers on a line (false if any token is not a
+// number)
+static bool ParseNumbers(const std::string &line, std::vector<float> &numbers){
+  numbers.clear();
+  const char *p = line.c_str();
+  while(true){
+    while(*p == ' ' || *p == '\t') p++;
+    if(*p == '\0') return true;
+    char *end;
+    float value = strtof(p, &end);
+    if(end == p || (*end != ' ' && *end != '\t' && *end != '\0')) return false;
+    numbers.push_back(value);
+    p = end;
+  }
+}
+
+static bool IsIncreasing(const std::vector<float> &values){
+  for(int n = 1; n < values.size(); n++){
+    if(!(values[n] > values[(n-1)])) return false;
+  }
+  return true;
+}
+
+// Calibration lines ("key: value unit") up to the next line without a key
+static bool ReadCalibration(BeamDataReader &reader, float &k, float &d_0,
+    float &SSD_0, float &SSD_PDD){
+  std::string line;
+  bool found[4] = {false, false, false, false};
+  float *values[4] = {&k, &d_0, &SSD_0, &SSD_PDD};
+  const char *keys[4] = {"k", "d_0", "SSD_0", "SSD_PDD"};
+  while(reader.NextLine(line)){
+    size_t colon = line.find(':');
+    if(colon == std::string::npos){
+      reader.Unread();
+      break;
     }
+    std::string key = line.substr(0, colon);
+    int n = 0;
+    while(n < 4 && key != keys[n]) n++;
+    if(n == 4) return reader.Error("unknown calibration value \"" + key + "\"");
+    const char *value = line.c_str() + colon + 1;
+    char *end;
+    *values[n] = strtof(value, &end);
+    if(end == value) return reader.Error("no number for \"" + key + "\"");
+    found[n] = true;
   }
-  for(int n = 0; n < 3; n++){ std::getline(fin, input); }
-  
-  // Get PDD table
-  std::getline(fin, input);
-  p1 = 0; p2 = input.find(' ');
-  while(p1 != std::string::npos){
-    std::stringstream(input.substr(p1,p2-p1)) >> temp;
-    r_pdd.push_back(temp);
-    p1 = p2; p2 = input.find(' ',p1+1);
+  for(int n = 0; n < 4; n++){
+    if(!found[n]) return reader.Error(std::string("missing calibration "
+        "value \"") + keys[n] + "\"");
   }
-  
-  reading = true;
-  while(reading){
-    std::getline(fin, input);
-    
-    if(input == "end pdd table"){
-      reading = false;
+  return true;
+}
+
+// Scatter factor rows (r, S_c, S_p) after an optional column heading
+static bool ReadScatterFactors(BeamDataReader &reader,
+    std::vector<float> &r_scatter, std::vector<float> &S_c_data,
+    std::vector<float> &S_p_data){
+  std::string line;
+  std::vector<float> numbers;
+  bool first = true;
+  while(reader.NextLine(line)){
+    if(line == "end scatter factors"){
+      if(r_scatter.size() < 2){
+        return reader.Error("at least two scatter factors are needed");
+      }
+      return true;
+    }
+    bool numeric = ParseNumbers(line, numbers);
+    if(first && !numeric){
+      first = false;
       continue;
     }
-    
-    std::vector<float> buffer;
-    p1 = 0; p2 = input.find(' ');
-    std::stringstream(input.substr(p1,p2-p1)) >> temp;
-    d_pdd.push_back(temp);
-    //std::cout << temp << '\n';
-    p1 = p2; p2 = input.find(' ',p1+1);
-    while(p1 != std::string::npos){
-      std::stringstream(input.substr(p1,p2-p1)) >> temp;
-      buffer.push_back(temp);
-      p1 = p2; p2 = input.find(' ',p1+1);
-      //std::cout << temp << '\n';
+    first = false;
+    if(!numeric || numbers.size() != 3){
+      return reader.Error("expected 3 numbers (r, S_c, S_p)");
+    }
+    if(!r_scatter.empty() && !(numbers[0] > r_scatter.back())){
+      return reader.Error("field sizes must increase");
     }
-    
-    pdd_data.push_back(buffer);
+    r_scatter.push_back(numbers[0]);
+    S_c_data.push_back(numbers[1]);
+    S_p_data.push_back(numbers[2]);
+  }
+  return reader.Error("missing \"end scatter factors\"");
+}
+
+// 2D table: a line of column samples, then rows of a row sample followed by
+// one value per column, up to end_line
+static bool ReadTable(BeamDataReader &reader, const std::string &end_line,
+    std::vector<float> &columns, std::vector<float> &rows,
+    std::vector< std::vector<float> > &data){
+  std::string line;
+  std::vector<float> numbers;
+  if(!reader.NextLine(line) || !ParseNumbers(line, columns)){
+    return reader.Error("expected a line of column values");
+  }
+  if(columns.size() < 2 || !IsIncreasing(columns)){
+    return reader.Error("at least two increasing column values are needed");
+  }
+  while(reader.NextLine(line)){
+    if(line == end_line){
+      if(rows.size() < 2) return reader.Error("at least two rows are needed");
+      return true;
+    }
+    if(!ParseNumbers(line, numbers) || numbers.size() != columns.size()+1){
+      std::stringstream message;
+      message << "expected " << columns.size()+1 << " numbers";
+      return reader.Error(message.str());
+    }
+    if(!rows.empty() && !(numbers[0] > rows.back())){
+      return reader.Error("row values must increase");
+    }
+    rows.push_back(numbers[0]);
+    data.push_back(std::vector<float>(numbers.begin()+1, numbers.end()));
+  }
+  return reader.Error("missing \"" + end_line + "\"");
+}
+
+void CBDose::ClearData(){
+  name.clear();
+  k = d_0 = SSD_0 = SSD_PDD = 0.0;
+  r_scatter.clear();
+  S_c_data.clear();
+  S_p_data.clear();
+  r_pdd.clear();
+  d_pdd.clear();
+  pdd_data.clear();
+  r_tpr.clear();
+  d_tpr.clear();
+  tpr_data.clear();
+  oad_oar.clear();
+  d_oar.clear();
+  oar_data.clear();
+  tpr_table.clear();
+  oar_table.clear();
+  uniform_error = 0.0;
+  uniform_S_c = UniformTable();
+  uniform_S_p = UniformTable();
+  uniform_pdd = UniformTable();
+  uniform_tpr = UniformTable();
+  uniform_oar = UniformTable();
+}
+
+// Read a whole file into memory (false if it cannot be read)
+static bool ReadFile(const std::string &file_name, std::string &contents){
+  std::ifstream fin(file_name.c_str(), std::ios::binary);
+  if(!fin.is_open()) return false;
+  fin.seekg(0, std::ios::end);
+  contents.resize(fin.tellg());
+  fin.seekg(0, std::ios::beg);
+  if(!contents.empty()) fin.read(&contents[0], contents.size());
+  return bool(fin);
+}
+
+bool CBDose::LoadData(std::string file_name, bool verbose){
+  ClearData();
+  std::string text;
+  if(!ReadFile(file_name, text)){
+    std::cout << "Error: could not read beam data file \"" << file_name <<
+        "\"!\n";
+    return false;
   }
-  for(int n = 0; n < 2; n++){ std::getline(fin, input); }
-  
-  // Get TPR table
   
-  // Read if TPR data is available, else calculate from PDD
-  if(input == "TPR Table"){
-    for(int n = 0; n < 2; n++){ std::getline(fin, input); }
-    p1 = 0; p2 = input.find(' ');
-    while(p1 != std::string::npos){
-      std::stringstream(input.substr(p1,p2-p1)) >> temp;
-      r_tpr.push_back(temp);
-      p1 = p2; p2 = input.find(' ',p1+1);
+  // Title, then sections in any order
+  BeamDataReader reader(text, file_name);
+  std::string line;
+  bool calibration = false, scatter = false, pdd = false, tpr = false,
+      tpr_from_pdd = false, oar = false, valid = true;
+  if(!reader.NextLine(line)) valid = reader.Error("file is empty");
+  else name = line;
+  while(valid && reader.NextLine(line)){
+    if(line == "Calibration Data"){
+      valid = calibration = ReadCalibration(reader, k, d_0, SSD_0, SSD_PDD);
     }
-    
-    reading = true;
-    while(reading){
-      std::getline(fin, input);
-      
-      if(input == "end tpr table"){
-        reading = false;
-        continue;
-      }
-      
-      std::vector<float> buffer;
-      p1 = 0; p2 = input.find(' ');
-      std::stringstream(input.substr(p1,p2-p1)) >> temp;
-      d_tpr.push_back(temp);
-      //std::cout << temp << '\n';
-      p1 = p2; p2 = input.find(' ',p1+1);
-      while(p1 != std::string::npos){
-        std::stringstream(input.substr(p1,p2-p1)) >> temp;
-        buffer.push_back(temp);
-        p1 = p2; p2 = input.find(' ',p1+1);
-        //std::cout << temp << '\n';
-      }
-      
-      tpr_data.push_back(buffer);
+    else if(line == "Scatter Factors"){
+      valid = scatter = ReadScatterFactors(reader, r_scatter, S_c_data,
+          S_p_data);
+    }
+    else if(line == "PDD Table"){
+      valid = pdd = ReadTable(reader, "end pdd table", r_pdd, d_pdd, pdd_data);
     }
-    for(int n = 0; n < 3; n++){ std::getline(fin, input); }
+    else if(line == "TPR Table"){
+      valid = tpr = ReadTable(reader, "end tpr table", r_tpr, d_tpr, tpr_data);
+    }
+    else if(line == "no tpr table"){
+      tpr_from_pdd = true;
+    }
+    else if(line == "OAR Table"){
+      valid = oar = ReadTable(reader, "end oar table", oad_oar, d_oar,
+          oar_data);
+    }
+    else valid = reader.Error("unknown section \"" + line + "\"");
+  }
+  const char *missing = nullptr;
+  if(!calibration) missing = "Calibration Data";
+  else if(!scatter) missing = "Scatter Factors";
+  else if(!pdd) missing = "PDD Table";
+  else if(!tpr && !tpr_from_pdd) missing = "TPR Table";
+  else if(!oar) missing = "OAR Table";
+  if(valid && missing){
+    valid = reader.Error(std::string("missing section \"") + missing + "\"");
   }
-  else if(input == "no tpr table"){
-    std::cout << "No TPR data found, calculating from PDD data...\n";
+  if(!valid){
+    ClearData();
+    return false;
+  }
+  
+  if(verbose){
+    std::cout << name << '\n';
+    std::cout << "Calibration constant (k) = " << k << " cGy/MU @ " << d_0 <<
+        " cm\n";
+    std::cout << "PDD measured using " << SSD_PDD << " cm SSD\n";
+  }
+  
+  // Without TPR data, it is calculated from the PDD data
+  if(!tpr){
+    if(verbose){
+      std::cout << "No TPR data found, calculating from PDD data...\n";
+    }
     for(int n = 1; n < r_pdd.size(); n++) r_tpr.push_back(r_pdd[n]);
     for(int n = 0; n < d_pdd.size(); n++) d_tpr.push_back(d_pdd[n]);
     for(int n_d = 0; n_d < d_tpr.size(); n_d++){
@@ -242,59 +422,340 @@ void CBDose::LoadData(std::string file_name){
       }
       tpr_data.push_back(buffer);
     }
-    for(int n = 0; n < 4; n++){ std::getline(fin, input); }
   }
-  else {
-    std::cout << "Error in reading/calculating TPR data!\n";
-    for(int n = 0; n < 2; n++){ std::getline(fin, input); }
+  
+  FlattenTables();
+  if(uniform_steps[0] > 0 && BuildUniformTables(uniform_steps[0],
+      uniform_steps[1], uniform_steps[2]) && verbose){
+    std::cout << "Uniform beam tables, maximum deviation = " <<
+        100.0*uniform_error << "%\n";
+  }
+  return true;
+}
+
+// Rows one after another (every row has one value per column sample)
+static std::vector<float> FlattenTable(
+    const std::vector< std::vector<float> > &data){
+  std::vector<float> table;
+  for(int n = 0; n < data.size(); n++){
+    table.insert(table.end(), data[n].begin(), data[n].end());
+  }
+  return table;
+}
+
+void CBDose::FlattenTables(){
+  tpr_table = FlattenTable(tpr_data);
+  oar_table = FlattenTable(oar_data);
+}
+
+// Binary beam model file (host byte order, checked on load): a header with
+// the scalar data and the size of every table, followed by the tables as
+// 32-bit floats in the order of the header, and then the name
+const char kBeamModelMagic[8] = {'S', 'O', 'L', 'C', 'B', 'E', 'A', 'M'};
+const uint32_t kBeamModelVersion = 1;
+const uint32_t kBeamModelEndianCheck = 0x01020304;
+
+struct BeamModelHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t endian_check;
+  uint64_t file_size;
+  float k, d_0, SSD_0, SAD, SSD_PDD;
+  float uniform_steps[3];
+  float uniform_error;
+  uint32_t name_length;
+  uint32_t num_scatter; // r_scatter, S_c, S_p
+  uint32_t pdd_size[2]; // Depths, field sizes
+  uint32_t tpr_size[2];
+  uint32_t oar_size[2]; // Depths, off-axis distances
+  uint32_t uniform_size[5][2]; // S_c, S_p, PDD, TPR, OAR (0 if not built)
+  float uniform_grid[5][4]; // x_0, x_scale, y_0, y_scale
+};
+
+static void AppendFloats(std::vector<char> &buffer,
+    const std::vector<float> &values){
+  if(values.empty()) return;
+  size_t offset = buffer.size();
+  buffer.resize(offset + values.size()*sizeof(float));
+  memcpy(&buffer[offset], &values[0], values.size()*sizeof(float));
+}
+
+static void ReadFloats(const char *&data, size_t size,
+    std::vector<float> &values){
+  values.resize(size);
+  if(size > 0) memcpy(&values[0], data, size*sizeof(float));
+  data += size*sizeof(float);
+}
+
+static void ReadRows(const char *&data, size_t rows, size_t columns,
+    std::vector< std::vector<float> > &table){
+  table.resize(rows);
+  for(int n = 0; n < rows; n++) ReadFloats(data, columns, table[n]);
+}
+
+bool CBDose::SaveModel(std::string file_name){
+  if(r_scatter.empty() || tpr_table.empty() || oar_table.empty()){
+    std::cout << "Error: beam data not loaded!\n";
+    return false;
+  }
+  BeamModelHeader header;
+  memset(&header, 0, sizeof(BeamModelHeader));
+  memcpy(header.magic, kBeamModelMagic, 8);
+  header.version = kBeamModelVersion;
+  header.endian_check = kBeamModelEndianCheck;
+  header.k = k;
+  header.d_0 = d_0;
+  header.SSD_0 = SSD_0;
+  header.SAD = SAD;
+  header.SSD_PDD = SSD_PDD;
+  for(int n = 0; n < 3; n++) header.uniform_steps[n] = uniform_steps[n];
+  header.uniform_error = uniform_error;
+  header.name_length = name.size();
+  header.num_scatter = r_scatter.size();
+  header.pdd_size[0] = d_pdd.size();
+  header.pdd_size[1] = r_pdd.size();
+  header.tpr_size[0] = d_tpr.size();
+  header.tpr_size[1] = r_tpr.size();
+  header.oar_size[0] = d_oar.size();
+  header.oar_size[1] = oad_oar.size();
+  const UniformTable *uniform[5] = {&uniform_S_c, &uniform_S_p, &uniform_pdd,
+      &uniform_tpr, &uniform_oar};
+  for(int n = 0; n < 5; n++){
+    if(uniform[n]->values.empty()) continue;
+    header.uniform_size[n][0] = uniform[n]->x_size;
+    header.uniform_size[n][1] = uniform[n]->y_size;
+    header.uniform_grid[n][0] = uniform[n]->x_0;
+    header.uniform_grid[n][1] = uniform[n]->x_scale;
+    header.uniform_grid[n][2] = uniform[n]->y_0;
+    header.uniform_grid[n][3] = uniform[n]->y_scale;
   }
   
-  // Get OAR table
-  std::getline(fin, input);
-  std::cout << input << '\n';
-  p1 = 0; p2 = input.find(' ');
-  while(p1 != std::string::npos){
-    std::stringstream(input.substr(p1,p2-p1)) >> temp;
-    oad_oar.push_back(temp);
-    p1 = p2; p2 = input.find(' ',p1+1);
+  std::vector<char> buffer(sizeof(BeamModelHeader));
+  AppendFloats(buffer, r_scatter);
+  AppendFloats(buffer, S_c_data);
+  AppendFloats(buffer, S_p_data);
+  AppendFloats(buffer, d_pdd);
+  AppendFloats(buffer, r_pdd);
+  for(int n = 0; n < pdd_data.size(); n++) AppendFloats(buffer, pdd_data[n]);
+  AppendFloats(buffer, d_tpr);
+  AppendFloats(buffer, r_tpr);
+  AppendFloats(buffer, tpr_table);
+  AppendFloats(buffer, d_oar);
+  AppendFloats(buffer, oad_oar);
+  AppendFloats(buffer, oar_table);
+  for(int n = 0; n < 5; n++) AppendFloats(buffer, uniform[n]->values);
+  buffer.insert(buffer.end(), name.begin(), name.end());
+  header.file_size = buffer.size();
+  memcpy(&buffer[0], &header, sizeof(BeamModelHeader));
+  
+  std::ofstream fout(file_name.c_str(), std::ios::binary);
+  fout.write(&buffer[0], buffer.size());
+  fout.close();
+  if(!fout){
+    std::cout << "Error: could not write beam model file \"" << file_name <<
+        "\"!\n";
+    return false;
+  }
+  return true;
+}
+
+bool CBDose::LoadModel(std::string file_name){
+  ClearData();
+  std::string contents;
+  if(!ReadFile(file_name, contents)){
+    std::cout << "Error: could not read beam model file \"" << file_name <<
+        "\"!\n";
+    return false;
   }
   
-  reading = true;
-  while(reading){
-    std::getline(fin, input);
-    
-    if(input == "end oar table"){
-      reading = false;
+  // Check the header and that the sizes account for the whole file before
+  // reading any tables
+  BeamModelHeader header;
+  bool valid = (contents.size() >= sizeof(BeamModelHeader));
+  if(valid){
+    memcpy(&header, &contents[0], sizeof(BeamModelHeader));
+    valid = (memcmp(header.magic, kBeamModelMagic, 8) == 0 &&
+        header.endian_check == kBeamModelEndianCheck);
+  }
+  if(valid && header.version != kBeamModelVersion){
+    std::cout << "Error: beam model file \"" << file_name << "\" has " <<
+        "version " << header.version << " (expected " << kBeamModelVersion <<
+        ")!\n";
+    return false;
+  }
+  uint64_t num_floats = 3*uint64_t(header.num_scatter);
+  const uint32_t *sizes[3] = {header.pdd_size, header.tpr_size,
+      header.oar_size};
+  for(int n = 0; valid && n < 3; n++){
+    valid = (sizes[n][0] >= 2 && sizes[n][1] >= 2);
+    num_floats += sizes[n][0] + sizes[n][1] + uint64_t(sizes[n][0])*sizes[n][1];
+  }
+  // The uniform tables are all present or all absent: S_c and S_p are 1D
+  // (one column), PDD, TPR and OAR are 2D, with finite positive scales
+  bool has_uniform = (header.uniform_size[0][0] != 0);
+  for(int n = 0; valid && n < 5; n++){
+    uint32_t x_size = header.uniform_size[n][0];
+    uint32_t y_size = header.uniform_size[n][1];
+    const float *grid = header.uniform_grid[n];
+    if(!has_uniform){
+      valid = (x_size == 0 && y_size == 0);
       continue;
     }
-    
-    std::vector<float> buffer;
-    p1 = 0; p2 = input.find(' ');
-    std::stringstream(input.substr(p1,p2-p1)) >> temp;
-    d_oar.push_back(temp);
-    p1 = p2; p2 = input.find(' ',p1+1);
-    while(p1 != std::string::npos){
-      std::stringstream(input.substr(p1,p2-p1)) >> temp;
-      buffer.push_back(temp);
-      p1 = p2; p2 = input.find(' ',p1+1);
-    }
-    
-    oar_data.push_back(buffer);
+    valid = (x_size >= 2 && ((n < 2) ? (y_size == 1) : (y_size >= 2)) &&
+        std::isfinite(grid[0]) && std::isfinite(grid[1]) && grid[1] > 0 &&
+        std::isfinite(grid[2]) && std::isfinite(grid[3]) &&
+        ((n < 2) || grid[3] > 0));
+    num_floats += uint64_t(x_size)*y_size;
+  }
+  valid = valid && header.num_scatter >= 2 && header.file_size ==
+      contents.size() && num_floats < contents.size() && header.file_size ==
+      sizeof(BeamModelHeader) + num_floats*sizeof(float) + header.name_length;
+  if(!valid){
+    std::cout << "Error: \"" << file_name << "\" is not a valid beam model " <<
+        "file!\n";
+    return false;
   }
   
-  // Close file
-  fin.close();
+  k = header.k;
+  d_0 = header.d_0;
+  SSD_0 = header.SSD_0;
+  SAD = header.SAD;
+  SSD_PDD = header.SSD_PDD;
+  for(int n = 0; n < 3; n++) uniform_steps[n] = header.uniform_steps[n];
+  const char *data = &contents[sizeof(BeamModelHeader)];
+  ReadFloats(data, header.num_scatter, r_scatter);
+  ReadFloats(data, header.num_scatter, S_c_data);
+  ReadFloats(data, header.num_scatter, S_p_data);
+  ReadFloats(data, header.pdd_size[0], d_pdd);
+  ReadFloats(data, header.pdd_size[1], r_pdd);
+  ReadRows(data, header.pdd_size[0], header.pdd_size[1], pdd_data);
+  ReadFloats(data, header.tpr_size[0], d_tpr);
+  ReadFloats(data, header.tpr_size[1], r_tpr);
+  ReadRows(data, header.tpr_size[0], header.tpr_size[1], tpr_data);
+  ReadFloats(data, header.oar_size[0], d_oar);
+  ReadFloats(data, header.oar_size[1], oad_oar);
+  ReadRows(data, header.oar_size[0], header.oar_size[1], oar_data);
+  UniformTable *uniform[5] = {&uniform_S_c, &uniform_S_p, &uniform_pdd,
+      &uniform_tpr, &uniform_oar};
+  for(int n = 0; n < 5; n++){
+    uniform[n]->x_size = header.uniform_size[n][0];
+    uniform[n]->y_size = header.uniform_size[n][1];
+    uniform[n]->x_0 = header.uniform_grid[n][0];
+    uniform[n]->x_scale = header.uniform_grid[n][1];
+    uniform[n]->y_0 = header.uniform_grid[n][2];
+    uniform[n]->y_scale = header.uniform_grid[n][3];
+    ReadFloats(data, uint64_t(header.uniform_size[n][0])*
+        header.uniform_size[n][1], uniform[n]->values);
+  }
+  uniform_error = header.uniform_error;
+  name.assign(data, header.name_length);
+  FlattenTables();
+  return true;
+}
+
+void CBDose::SetUniformResolution(float depth_step, float size_step,
+    float oad_step){
+  uniform_steps[0] = depth_step;
+  uniform_steps[1] = size_step;
+  uniform_steps[2] = oad_step;
+}
+
+// Largest relative deviation of a uniform table from the source data, at
+// the source samples and the midpoints between them (1D if y_data is empty)
+template <class F>
+static float UniformDeviation(const UniformTable &table,
+    const std::vector<float> &x_data, const std::vector<float> &y_data,
+    F source){
+  std::vector<float> x_points, y_points;
+  for(int n = 0; n < x_data.size(); n++){
+    x_points.push_back(x_data[n]);
+    if(n > 0) x_points.push_back(0.5*(x_data[(n-1)] + x_data[n]));
+  }
+  for(int n = 0; n < y_data.size(); n++){
+    y_points.push_back(y_data[n]);
+    if(n > 0) y_points.push_back(0.5*(y_data[(n-1)] + y_data[n]));
+  }
+  if(y_points.empty()) y_points.push_back(0);
+  float error = 0;
+  for(int i = 0; i < x_points.size(); i++){
+    for(int j = 0; j < y_points.size(); j++){
+      float exact = source(x_points[i], y_points[j]);
+      float value = y_data.empty() ? table.Lookup(x_points[i]) :
+          table.Lookup(x_points[i], y_points[j]);
+      float deviation = fabs(value - exact);
+      if(exact != 0) deviation /= fabs(exact);
+      error = std::max(error, deviation);
+    }
+  }
+  return error;
 }
 
-// Get data from tables using linear interpolation
-float CBDose::GetS_c(float r){
-  return solutio::LinearInterpolation(r_scatter, S_c_data, r);
+bool CBDose::BuildUniformTables(float depth_step, float size_step,
+    float oad_step){
+  if(r_scatter.size() < 2 || d_pdd.size() < 2 || r_pdd.size() < 2 ||
+      d_tpr.size() < 2 || r_tpr.size() < 2 || d_oar.size() < 2 ||
+      oad_oar.size() < 2){
+    std::cout << "Error: beam data not loaded!\n";
+    return false;
+  }
+  if(!(depth_step > 0 && size_step > 0 && oad_step > 0)){
+    std::cout << "Error: uniform table steps must be positive!\n";
+    return false;
+  }
+  // The source tables are sampled directly, not through the Get functions,
+  // which switch to the uniform tables as they are built
+  auto S_c = [this](float r, float){
+    return solutio::LinearInterpolationSearch(r_scatter, S_c_data, r);
+  };
+  auto S_p = [this](float r, float){
+    return solutio::LinearInterpolationSearch(r_scatter, S_p_data, r);
+  };
+  auto pdd = [this](float d, float r){
+    return solutio::LinearInterpolationSearch(d_pdd, r_pdd, pdd_data, d, r);
+  };
+  auto tpr = [this](float d, float r){
+    return solutio::LinearInterpolationSearch(d_tpr, r_tpr, tpr_data, d, r);
+  };
+  auto oar = [this](float d, float oad){
+    return solutio::LinearInterpolationSearch(d_oar, oad_oar, oar_data, d,
+        oad);
+  };
+  uniform_S_c.Build(r_scatter.front(), r_scatter.back(), size_step, 0, 0, 0,
+      S_c);
+  uniform_S_p.Build(r_scatter.front(), r_scatter.back(), size_step, 0, 0, 0,
+      S_p);
+  uniform_pdd.Build(d_pdd.front(), d_pdd.back(), depth_step, r_pdd.front(),
+      r_pdd.back(), size_step, pdd);
+  uniform_tpr.Build(d_tpr.front(), d_tpr.back(), depth_step, r_tpr.front(),
+      r_tpr.back(), size_step, tpr);
+  uniform_oar.Build(d_oar.front(), d_oar.back(), depth_step, oad_oar.front(),
+      oad_oar.back(), oad_step, oar);
+  std::vector<float> none;
+  uniform_error = std::max(
+      UniformDeviation(uniform_S_c, r_scatter, none, S_c),
+      UniformDeviation(uniform_S_p, r_scatter, none, S_p));
+  uniform_error = std::max(uniform_error,
+      UniformDeviation(uniform_pdd, d_pdd, r_pdd, pdd));
+  uniform_error = std::max(uniform_error,
+      UniformDeviation(uniform_tpr, d_tpr, r_tpr, tpr));
+  uniform_error = std::max(uniform_error,
+      UniformDeviation(uniform_oar, d_oar, oad_oar, oar));
+  return true;
+}
+
+// Get data from tables using linear interpolation (uniform tables if built)
+float CBDose::GetS_c(float r) const {
+  if(!uniform_S_c.IsEmpty()) return uniform_S_c.Lookup(r);
+  return solutio::LinearInterpolationSearch(r_scatter, S_c_data, r);
 }
-float CBDose::GetS_p(float r){
-  return solutio::LinearInterpolation(r_scatter, S_p_data, r);
+float CBDose::GetS_p(float r) const {
+  if(!uniform_S_p.IsEmpty()) return uniform_S_p.Lookup(r);
+  return solutio::LinearInterpolationSearch(r_scatter, S_p_data, r);
 }
-float CBDose::GetPDD(float d, float r, float f){
-  float pdd_1 = solutio::LinearInterpolation(d_pdd, r_pdd, pdd_data, d, r);
+float CBDose::GetPDD(float d, float r, float f) const {
+  float pdd_1;
+  if(!uniform_pdd.IsEmpty()) pdd_1 = uniform_pdd.Lookup(d, r);
+  else pdd_1 = solutio::LinearInterpolationSearch(d_pdd, r_pdd, pdd_data, d, r);
   float pdd_2;
   if(f == SSD_PDD) pdd_2 = pdd_1;
   else {
@@ -308,22 +769,24 @@ float CBDose::GetPDD(float d, float r, float f){
   }
   return pdd_2;
 }
-float CBDose::GetTPR(float d, float r){
-  return solutio::LinearInterpolation(d_tpr, r_tpr, tpr_data, d, r);
+float CBDose::GetTPR(float d, float r) const {
+  if(!uniform_tpr.IsEmpty()) return uniform_tpr.Lookup(d, r);
+  return solutio::LinearInterpolationSearch(d_tpr, r_tpr, tpr_data, d, r);
 }
 
-float CBDose::GetOAR(float d, float oad){
-  return solutio::LinearInterpolation(d_oar, oad_oar, oar_data, d, oad);
+float CBDose::GetOAR(float d, float oad) const {
+  if(!uniform_oar.IsEmpty()) return uniform_oar.Lookup(d, oad);
+  return solutio::LinearInterpolationSearch(d_oar, oad_oar, oar_data, d, oad);
 }
 // Convert PDD(d, r, f) to TPR(d, r_d)
-float CBDose::PDDToTPR(float d, float r_d){
+float CBDose::PDDToTPR(float d, float r_d) const {
   float r = r_d*(SSD_PDD/(SSD_PDD+d));
   float r_d0 = r*((SSD_PDD+d_0)/SSD_PDD);
   return ( (GetPDD(d,r,SSD_PDD)/100.0) * pow(((SSD_PDD+d)/(SSD_PDD+d_0)),2.0) * (GetS_p(r_d0)/GetS_p(r_d)) );
 }
 // Calculate dose or monitor units, depending on variable "type"
-float CBDose::CalcDose(float mu, LinacBeam &beam, CalcPoint &point, 
-    std::string type){
+float CBDose::CalcDose(float mu, const LinacBeam &beam,
+    const CalcPoint &point, std::string type) const {
   // Calculate source to point distance
   float SPD = beam.GetSSD() + point.GetDepth();
   // Calculate field sizes
@@ -335,11 +798,16 @@ float CBDose::CalcDose(float mu, LinacBeam &beam, CalcPoint &point,
   float S_c = GetS_c(r_c);
   float S_p;
   if(type == "SAD") S_p = GetS_p(r_d);
-  else GetS_p(r_0);
+  else S_p = GetS_p(r_0);
   // Get PDD/TPR
   float depth_dose;
   if(type == "SAD") depth_dose = GetTPR(point.GetDepth(), r_d);
   else depth_dose = GetPDD(point.GetDepth(), r, beam.GetSSD()) / 100.0;
+  // Equivalent path length correction
+  if(point.GetRadiologicalDepth() != point.GetDepth()){
+    depth_dose *= GetTPR(point.GetRadiologicalDepth(), r_d) /
+        GetTPR(point.GetDepth(), r_d);
+  }
   // Calculate inverse square factor
   float isf;
   if(type == "SAD") isf = pow(((GetSSD_0()+Getd_0())/SPD),2.0);
@@ -350,7 +818,180 @@ float CBDose::CalcDose(float mu, LinacBeam &beam, CalcPoint &point,
   return ( mu * (Getk()*S_c*S_p*depth_dose*isf*OAR) );
 }
 
-float CBDose::CalcMU(float dose, LinacBeam &beam, CalcPoint &point, 
-    std::string type){
+float CBDose::CalcMU(float dose, const LinacBeam &beam,
+    const CalcPoint &point, std::string type) const {
   return ( dose / CalcDose(1.0, beam, point, type) );
 }
+
+// Linear interpolation in a contiguous 2D table at the interval ending at
+// (x_index, y_index), as in solutio::LinearInterpolationSearch
+static inline float TableInterpolation(const float *x_data,
+    const float *y_data, const float *table, int columns, float x_value,
+    float y_value, int x_index, int y_index){
+  // Offsets from the table start (not row pointers) keep gathers in 32 bits
+  int n_1 = (x_index-1)*columns + y_index;
+  int n_2 = n_1 + columns;
+  float f_y = (y_value - y_data[(y_index-1)]) /
+      (y_data[y_index] - y_data[(y_index-1)]);
+  float y_1 = f_y*table[n_1] + (1-f_y)*table[(n_1-1)];
+  float y_2 = f_y*table[n_2] + (1-f_y)*table[(n_2-1)];
+  float f_x = (x_value - x_data[(x_index-1)]) /
+      (x_data[x_index] - x_data[(x_index-1)]);
+  return (f_x*y_2 + (1-f_x)*y_1);
+}
+
+bool CBDose::CalcDoseGrid(float mu, const LinacBeam &beam,
+    const std::vector<float> &depths, const std::vector<float> &oads,
+    std::vector<float> &doses, std::string type, int threads) const {
+  return DoseGrid(mu, beam, depths, nullptr, oads, doses, type, threads);
+}
+
+bool CBDose::CalcDoseGrid(float mu, const LinacBeam &beam,
+    const std::vector<float> &depths,
+    const std::vector<float> &radiological_depths,
+    const std::vector<float> &oads, std::vector<float> &doses,
+    std::string type, int threads) const {
+  if(radiological_depths.size() != depths.size()){
+    std::cout << "Error: number of depths and radiological depths differ!\n";
+    return false;
+  }
+  return DoseGrid(mu, beam, depths, radiological_depths.empty() ? nullptr :
+      &radiological_depths[0], oads, doses, type, threads);
+}
+
+bool CBDose::DoseGrid(float mu, const LinacBeam &beam,
+    const std::vector<float> &depths, const float *radiological_depths,
+    const std::vector<float> &oads, std::vector<float> &doses,
+    std::string type, int threads) const {
+  if(depths.size() != oads.size()){
+    std::cout << "Error: number of depths and off-axis distances differ!\n";
+    return false;
+  }
+  if(tpr_table.empty() || oar_table.empty() || r_scatter.empty()){
+    std::cout << "Error: beam data not loaded!\n";
+    return false;
+  }
+  int num_points = depths.size();
+  doses.resize(num_points);
+  if(num_points == 0) return true;
+  
+  // Beam quantities, as in CalcDose; for an SSD setup the field size, S_p
+  // and inverse square factor are fixed at the surface
+  BeamFactors factors;
+  factors.sad = (type == "SAD");
+  factors.SSD = beam.GetSSD();
+  factors.r_c = SquareField(beam.GetX(), beam.GetY());
+  factors.r = factors.r_c*(factors.SSD / GetSAD());
+  factors.kS_c = Getk()*GetS_c(factors.r_c);
+  if(!factors.sad){
+    float r_0 = factors.r_c*((factors.SSD + Getd_0()) / GetSAD());
+    factors.kS_cS_p = factors.kS_c*GetS_p(r_0);
+    factors.isf = pow(((GetSSD_0()+Getd_0()) / (factors.SSD+Getd_0())), 2.0);
+  }
+  const int points_per_task = 4096;
+  int num_tasks = (num_points + points_per_task - 1) / points_per_task;
+  solutio::ParallelFor(num_tasks, threads, [&](int task, int thread_id){
+    int begin = task*points_per_task;
+    int end = std::min(begin + points_per_task, num_points);
+    DoseBlock(mu, factors, &depths[0], &oads[0], &doses[0], begin, end);
+    if(radiological_depths == nullptr) return;
+    // Equivalent path length correction, as in CalcDose
+    for(int n = begin; n < end; n++){
+      float d = depths[n], d_rad = radiological_depths[n];
+      if(d_rad == d) continue;
+      float r_d = factors.r_c*((factors.SSD + d) / GetSAD());
+      doses[n] *= GetTPR(d_rad, r_d) / GetTPR(d, r_d);
+    }
+  });
+  return true;
+}
+
+// Points are done in blocks. Everything but the off-axis ratio depends only
+// on depth, so it is computed once per run of equal depths (dose grids list
+// the points of a depth together), with the intervals found by walking from
+// the previous ones (uniform tables need no search). The OAR interpolation
+// and doses are then computed without branches, so that loop can use SIMD
+// gathers.
+void CBDose::DoseBlock(float mu, const BeamFactors &beam,
+    const float *depths, const float *oads, float *doses, int begin,
+    int end) const {
+  const int block_size = 256;
+  float depth_factor[block_size], block_doses[block_size];
+  int oar_d_index[block_size], oad_index[block_size];
+  solutio::DataView<float> r_s_view(r_scatter), S_p_view(S_p_data),
+      d_tpr_view(d_tpr), r_tpr_view(r_tpr), d_oar_view(d_oar),
+      oad_view(oad_oar);
+  int s_hint = 0, tpr_d_hint = 0, tpr_r_hint = 0, oar_d_hint = 0,
+      oad_hint = 0;
+  // Local copies of the table pointers, and doses stored to a local block
+  // first, so the compiler can see that nothing in the loop aliases
+  const float *d_o = &d_oar[0], *oad_o = &oad_oar[0], *oar = &oar_table[0];
+  int oar_columns = oad_oar.size();
+  bool uniform = !uniform_oar.IsEmpty();
+  const float *u_oar = uniform ? &uniform_oar.values[0] : nullptr;
+  float u_oar_x_0 = uniform_oar.x_0, u_oar_x_scale = uniform_oar.x_scale;
+  float u_oar_y_0 = uniform_oar.y_0, u_oar_y_scale = uniform_oar.y_scale;
+  int u_oar_x_size = uniform_oar.x_size, u_oar_y_size = uniform_oar.y_size;
+  float isf_distance = GetSSD_0() + Getd_0();
+  float last_depth = 0.0, factor = 0.0;
+  int last_index = 1;
+  bool have_depth = false;
+  for(int first = begin; first < end; first += block_size){
+    int count = std::min(block_size, end - first);
+    const float *d = depths + first;
+    const float *oad = oads + first;
+    for(int n = 0; n < count; n++){
+      if(!have_depth || d[n] != last_depth){
+        have_depth = true;
+        last_depth = d[n];
+        float SPD = beam.SSD + d[n];
+        if(beam.sad){
+          float r_d = beam.r_c*(SPD / GetSAD());
+          float S_p, TPR;
+          if(uniform){
+            S_p = uniform_S_p.Lookup(r_d);
+            TPR = uniform_tpr.Lookup(d[n], r_d);
+          }
+          else {
+            S_p = solutio::LinearInterpolationHint(r_s_view, S_p_view, r_d,
+                s_hint);
+            TPR = TableInterpolation(&d_tpr[0], &r_tpr[0], &tpr_table[0],
+                r_tpr.size(), d[n], r_d,
+                solutio::BracketIndex(d_tpr_view, d[n], tpr_d_hint),
+                solutio::BracketIndex(r_tpr_view, r_d, tpr_r_hint));
+          }
+          float isf = pow((isf_distance/SPD), 2.0);
+          factor = beam.kS_c*S_p*TPR*isf;
+        }
+        else {
+          float depth_dose = GetPDD(d[n], beam.r, beam.SSD) / 100.0;
+          factor = beam.kS_cS_p*depth_dose*beam.isf;
+        }
+        if(!uniform){
+          last_index = solutio::BracketIndex(d_oar_view, d[n], oar_d_hint);
+        }
+      }
+      depth_factor[n] = factor;
+      oar_d_index[n] = last_index;
+    }
+    if(uniform){
+      for(int n = 0; n < count; n++){
+        float OAR = GridInterpolation(u_oar, u_oar_x_0, u_oar_x_scale,
+            u_oar_x_size, u_oar_y_0, u_oar_y_scale, u_oar_y_size, d[n],
+            oad[n]);
+        block_doses[n] = mu * (depth_factor[n]*OAR);
+      }
+    }
+    else {
+      for(int n = 0; n < count; n++){
+        oad_index[n] = solutio::BracketIndex(oad_view, oad[n], oad_hint);
+      }
+      for(int n = 0; n < count; n++){
+        float OAR = TableInterpolation(d_o, oad_o, oar, oar_columns, d[n],
+            oad[n], oar_d_index[n], oad_index[n]);
+        block_doses[n] = mu * (depth_factor[n]*OAR);
+      }
+    }
+    std::copy(block_doses, block_doses + count, doses + first);
+  }
+}
@@ -31,6 +31,8 @@
 #ifndef CBDOSE_HPP
 #define CBDOSE_HPP
 
+#include <algorithm>
+#include <cmath>
 #include <string>
 #include <vector>
 
@@ -41,13 +43,13 @@ class LinacBeam {
     void SetFieldSize(float x, float y);
     void SetFieldSize(float x1, float x2, float y1, float y2);
     void SetSSD(float ssd){ SSD = ssd; }
-    float GetX1(){ return X1; }
-    float GetX2(){ return X2; }
-    float GetY1(){ return Y1; }
-    float GetY2(){ return Y2; }
-    float GetX(){ return (X1-X2); }
-    float GetY(){ return (Y1-Y2); }
-    float GetSSD(){ return SSD; }
+    float GetX1() const { return X1; }
+    float GetX2() const { return X2; }
+    float GetY1() const { return Y1; }
+    float GetY2() const { return Y2; }
+    float GetX() const { return (X1-X2); }
+    float GetY() const { return (Y1-Y2); }
+    float GetSSD() const { return SSD; }
   private:
     // Beam setup data
     float X1; // X1 jaw position
@@ -60,14 +62,71 @@ class LinacBeam {
 // Class to represent calculation point
 class CalcPoint {
   public:
+    CalcPoint();
+    // Depth and off-axis distance (the radiological depth is reset to the
+    // depth, i.e. homogeneous water)
     void SetPoint(float d, float doa);
-    float GetDepth(){ return depth; }
-    float GetOAD(){ return off_axis_distance; }
+    // Water-equivalent depth, for a heterogeneity correction
+    void SetRadiologicalDepth(float d_rad){ radiological_depth = d_rad; }
+    float GetDepth() const { return depth; }
+    float GetOAD() const { return off_axis_distance; }
+    float GetRadiologicalDepth() const { return radiological_depth; }
   private:
     float depth;
     float off_axis_distance;
+    float radiological_depth;
 };
 
+// Class for beam data resampled on a regular grid (one column for 1D data),
+// looked up by direct index arithmetic; values outside the grid are
+// extrapolated linearly from the edge cells, like the source tables
+class UniformTable {
+  public:
+    UniformTable();
+    // Grid spanning [x_first, x_last] x [y_first, y_last] with steps of at
+    // most dx and dy, filled by evaluating f(x, y) at each node
+    template <class F>
+    void Build(float x_first, float x_last, float dx, float y_first,
+        float y_last, float dy, F f);
+    bool IsEmpty() const { return values.empty(); }
+    float Lookup(float x) const;
+    float Lookup(float x, float y) const;
+    // Grid layout, for loops that inline the lookup
+    float x_0, x_scale; // First node and 1/step
+    int x_size;
+    float y_0, y_scale;
+    int y_size;
+    std::vector<float> values; // Row by row (x major)
+};
+
+// Number of nodes for a regular grid over [first, last] with spacing of at
+// most step (at least 2 nodes). A step that divides the range keeps the
+// source samples on the grid despite rounding, and the grid then reproduces
+// the bilinear source interpolation.
+inline int UniformNodes(float first, float last, float step){
+  if(!(step > 0) || !(last > first)) return 2;
+  return std::max(2, int(ceil((last - first)/step - 1.0e-3)) + 1);
+}
+
+template <class F>
+void UniformTable::Build(float x_first, float x_last, float dx, float y_first,
+    float y_last, float dy, F f){
+  x_size = UniformNodes(x_first, x_last, dx);
+  y_size = (dy > 0) ? UniformNodes(y_first, y_last, dy) : 1;
+  float x_step = (x_last - x_first)/(x_size - 1);
+  float y_step = (y_size > 1) ? (y_last - y_first)/(y_size - 1) : 0;
+  x_0 = x_first;
+  x_scale = (x_step > 0) ? 1/x_step : 0;
+  y_0 = y_first;
+  y_scale = (y_step > 0) ? 1/y_step : 0;
+  values.resize(x_size*y_size);
+  for(int i = 0; i < x_size; i++){
+    for(int j = 0; j < y_size; j++){
+      values[(i*y_size + j)] = f(x_first + i*x_step, y_first + j*y_step);
+    }
+  }
+}
+
 // Utility calculation equations
 float SquareField(float a, float b);
 float SquareField(float r);
@@ -81,25 +140,89 @@ float AnalyticPenumbraModel(float oad, float field_size);
 class CBDose {
   public:
     CBDose();
-    // Load beam data from text file
-    void LoadData(std::string file_name);
+    // Load beam data from text file, in one pass over its contents. Sections
+    // are found by their headings and every table row is checked, so
+    // malformed input is reported with its line number; nothing is kept if
+    // the file is invalid (returns true if successful). The title and
+    // calibration data are printed if verbose.
+    bool LoadData(std::string file_name, bool verbose = false);
+    // Save/load the loaded beam data, and the uniform tables if built, as a
+    // versioned binary model file that is read back without any parsing
+    // (returns true if successful)
+    bool SaveModel(std::string file_name);
+    bool LoadModel(std::string file_name);
     // Get data from memory
-    float Getk(){ return k; };
-    float Getd_0(){ return d_0; };
-    float GetSSD_0(){ return SSD_0; };
-    float GetSAD(){ return SAD; };
-    float GetS_c(float r);
-    float GetS_p(float r);
-    float GetPDD(float d, float r, float f);
-    float GetTPR(float d, float r);
-    float GetOAR(float d, float oad);
-    // Calculation functions
-    float PDDToTPR(float d, float r_d);
-    float CalcDose(float mu, LinacBeam &beam, CalcPoint &point, 
-        std::string type = "SAD");
-    float CalcMU(float dose, LinacBeam &beam, CalcPoint &point, 
-        std::string type = "SAD");
+    std::string GetName() const { return name; };
+    float Getk() const { return k; };
+    float Getd_0() const { return d_0; };
+    float GetSSD_0() const { return SSD_0; };
+    float GetSAD() const { return SAD; };
+    float GetS_c(float r) const;
+    float GetS_p(float r) const;
+    float GetPDD(float d, float r, float f) const;
+    float GetTPR(float d, float r) const;
+    float GetOAR(float d, float oad) const;
+    // Resample the beam data on regular grids, with steps (in cm) of at most
+    // depth_step, size_step and oad_step, and serve all lookups from them.
+    // The largest relative deviation from the source tables, found at the
+    // source samples and halfway between them, is kept for
+    // GetUniformTableError.
+    bool BuildUniformTables(float depth_step, float size_step,
+        float oad_step);
+    // Steps for LoadData to build the uniform tables with (0 = keep using
+    // the source tables)
+    void SetUniformResolution(float depth_step, float size_step,
+        float oad_step);
+    bool HasUniformTables() const { return !uniform_tpr.IsEmpty(); }
+    float GetUniformTableError() const { return uniform_error; }
+    // Calculation functions (these only read the beam data, so one loaded
+    // CBDose can be shared by several threads). Points with a radiological
+    // depth different from their depth get an equivalent path length
+    // correction, TPR(d_rad, r_d)/TPR(d, r_d).
+    float PDDToTPR(float d, float r_d) const;
+    float CalcDose(float mu, const LinacBeam &beam, const CalcPoint &point,
+        std::string type = "SAD") const;
+    float CalcMU(float dose, const LinacBeam &beam, const CalcPoint &point,
+        std::string type = "SAD") const;
+    // Dose for one beam at many points (depths and off-axis distances), in
+    // parallel (0 threads = all hardware threads). Quantities that depend
+    // only on the beam are computed once, and each point gets the same dose
+    // as from CalcDose.
+    bool CalcDoseGrid(float mu, const LinacBeam &beam,
+        const std::vector<float> &depths, const std::vector<float> &oads,
+        std::vector<float> &doses, std::string type = "SAD",
+        int threads = 0) const;
+    // Same, with the equivalent path length correction for the given
+    // radiological depths (doses as from CalcDose, up to rounding)
+    bool CalcDoseGrid(float mu, const LinacBeam &beam,
+        const std::vector<float> &depths,
+        const std::vector<float> &radiological_depths,
+        const std::vector<float> &oads, std::vector<float> &doses,
+        std::string type = "SAD", int threads = 0) const;
   private:
+    // Remove all beam data (the uniform table steps and SAD are kept)
+    void ClearData();
+    // Contiguous copies of the 2D tables (row by row), for CalcDoseGrid
+    void FlattenTables();
+    // Quantities of one beam that do not depend on the point
+    struct BeamFactors {
+      bool sad;
+      float SSD; // Beam SSD
+      float r_c; // Equivalent square at the SAD
+      float r; // Equivalent square at the surface
+      float kS_c; // k*S_c
+      float kS_cS_p; // k*S_c*S_p (SSD setup)
+      float isf; // Inverse square factor (SSD setup)
+    };
+    // CalcDoseGrid, with radiological depths if not null
+    bool DoseGrid(float mu, const LinacBeam &beam,
+        const std::vector<float> &depths, const float *radiological_depths,
+        const std::vector<float> &oads, std::vector<float> &doses,
+        std::string type, int threads) const;
+    // Dose for points [begin, end) of a grid
+    void DoseBlock(float mu, const BeamFactors &beam, const float *depths,
+        const float *oads, float *doses, int begin, int end) const;
+    std::string name; // Title line of the beam data file
     float k; // Calibration constant in cGy/MU
     float d_0; // Depth of calibration in cm
     float SSD_0; // Calibration SSD, in cm
@@ -121,6 +244,17 @@ class CBDose {
     std::vector<float> oad_oar;
     std::vector<float> d_oar;
     std::vector< std::vector<float> > oar_data;
+    
+    std::vector<float> tpr_table;
+    std::vector<float> oar_table;
+    
+    float uniform_steps[3]; // Depth, field size, off-axis distance
+    float uniform_error;
+    UniformTable uniform_S_c;
+    UniformTable uniform_S_p;
+    UniformTable uniform_pdd;
+    UniformTable uniform_tpr;
+    UniformTable uniform_oar;
 };
 
 #endif
@@ -0,0 +1,110 @@
+/******************************************************************************/
+/*                                                                            */
+/* Copyright 2016-2017 Steven Dolly                                           */
+/*                                                                            */
+/* Licensed under the Apache License, Version 2.0 (the "License");            */
+/* you may not use this file except in compliance with the License.           */
+/* You may obtain a copy of the License at:                                   */
+/*                                                                            */
+/*     http://www.apache.org/licenses/LICENSE-2.0                             */
+/*                                                                            */
+/* Unless required by applicable law or agreed to in writing, software        */
+/* distributed under the License is distributed on an "AS IS" BASIS,          */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   */
+/* See the License for the specific language governing permissions and        */
+/* limitations under the License.                                             */
+/*                                                                            */
+/******************************************************************************/
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// MUCheck.cpp                                                                //
+// Secondary Monitor Unit Check Engine                                        //
+// Created October 16, 2026                                                   //
+//                                                                            //
+// This file contains the engine for plan-level secondary MU checks, which    //
+// schedules batches of independent checks across worker threads.             //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// Class header
+#include "MUCheck.hpp"
+
+// Standard C++ header files
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+// Solutio C++ headers
+#include "Utilities/ParallelFor.hpp"
+
+MUCheckEngine::MUCheckEngine(){
+  num_threads = 0;
+  statistics.num_records = 0;
+  statistics.num_plans = 0;
+  statistics.num_threads = 0;
+  statistics.seconds = 0.0;
+  statistics.records_per_second = 0.0;
+}
+
+int MUCheckEngine::AddBeamModel(std::shared_ptr<const CBDose> model){
+  if(!model){
+    std::cout << "Error: no beam model given!\n";
+    return -1;
+  }
+  models.push_back(model);
+  return (models.size() - 1);
+}
+
+bool MUCheckEngine::Run(const std::vector<MUCheckRecord> &records,
+    std::vector<MUCheckResult> &results){
+  for(int n = 0; n < records.size(); n++){
+    const MUCheckRecord &record = records[n];
+    if(record.model < 0 || record.model >= models.size()){
+      std::cout << "Error: MU check " << n << " (plan " << record.plan <<
+          ", field " << record.field << ") uses beam model " <<
+          record.model << ", but " << models.size() << " are loaded!\n";
+      return false;
+    }
+    if(record.type != "SAD" && record.type != "SSD"){
+      std::cout << "Error: MU check " << n << " (plan " << record.plan <<
+          ", field " << record.field << ") has unknown setup type \"" <<
+          record.type << "\"!\n";
+      return false;
+    }
+  }
+  int num_records = records.size();
+  results.resize(num_records);
+  
+  // Records are handed out in blocks, to keep the scheduling overhead small
+  // next to the calculation
+  const int block_size = 256;
+  int num_blocks = (num_records + block_size - 1)/block_size;
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  solutio::ParallelFor(num_blocks, num_threads, [&](int block, int){
+    int end = std::min((block+1)*block_size, num_records);
+    for(int n = block*block_size; n < end; n++){
+      const MUCheckRecord &record = records[n];
+      results[n].plan = record.plan;
+      results[n].field = record.field;
+      results[n].mu = models[record.model]->CalcMU(record.dose, record.beam,
+          record.point, record.type);
+    }
+  });
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  
+  std::vector<int> plans(num_records);
+  for(int n = 0; n < num_records; n++) plans[n] = records[n].plan;
+  std::sort(plans.begin(), plans.end());
+  statistics.num_records = num_records;
+  statistics.num_plans = std::unique(plans.begin(), plans.end()) -
+      plans.begin();
+  statistics.num_threads = std::max(1, std::min(
+      solutio::ResolveThreadCount(num_threads), num_blocks));
+  statistics.seconds = elapsed.count();
+  statistics.records_per_second = (elapsed.count() > 0) ?
+      (num_records/elapsed.count()) : 0.0;
+  return true;
+}
@@ -0,0 +1,96 @@
+/******************************************************************************/
+/*                                                                            */
+/* Copyright 2016-2017 Steven Dolly                                           */
+/*                                                                            */
+/* Licensed under the Apache License, Version 2.0 (the "License");            */
+/* you may not use this file except in compliance with the License.           */
+/* You may obtain a copy of the License at:                                   */
+/*                                                                            */
+/*     http://www.apache.org/licenses/LICENSE-2.0                             */
+/*                                                                            */
+/* Unless required by applicable law or agreed to in writing, software        */
+/* distributed under the License is distributed on an "AS IS" BASIS,          */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   */
+/* See the License for the specific language governing permissions and        */
+/* limitations under the License.                                             */
+/*                                                                            */
+/******************************************************************************/
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// MUCheck.hpp                                                                //
+// Secondary Monitor Unit Check Engine Header File                            //
+// Created October 16, 2026                                                   //
+//                                                                            //
+// This header file contains the engine for plan-level secondary MU checks.   //
+// A batch of independent checks (one field of a plan and a reference point   //
+// each) is calculated with corrections-based beam models across worker       //
+// threads; the beam models are loaded once and shared by all workers.        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// Header guard
+#ifndef MUCHECK_HPP
+#define MUCHECK_HPP
+
+// Standard C++ header files
+#include <memory>
+#include <string>
+#include <vector>
+
+// Solutio C++ headers
+#include "Therapy/CBDose.hpp"
+
+// One MU check: the prescribed dose to a reference point from one field of
+// a plan, calculated with one of the engine's beam models
+struct MUCheckRecord {
+  MUCheckRecord() : plan(0), field(0), model(0), dose(0), type("SAD") {}
+  int plan; // Plan and field identifiers, copied to the result
+  int field;
+  int model; // Index returned by MUCheckEngine::AddBeamModel
+  LinacBeam beam;
+  CalcPoint point;
+  float dose; // Prescribed dose to the point, in cGy
+  std::string type; // "SAD" or "SSD" setup
+};
+
+struct MUCheckResult {
+  int plan;
+  int field;
+  float mu;
+};
+
+// Throughput of the last batch
+struct MUCheckStatistics {
+  int num_records;
+  int num_plans; // Distinct plan identifiers
+  int num_threads;
+  double seconds; // Wall time of the calculation
+  double records_per_second;
+};
+
+class MUCheckEngine {
+  public:
+    MUCheckEngine();
+    // Add a loaded beam model and return its index for MUCheckRecord::model
+    // (-1 if there is no model). Models are only read by the workers, and
+    // must not be changed while a batch is running.
+    int AddBeamModel(std::shared_ptr<const CBDose> model);
+    int GetNumBeamModels() const { return models.size(); }
+    // Number of worker threads (0 = all hardware threads)
+    void SetNumThreads(int threads){ num_threads = threads; }
+    // MU for every record (results[n] for records[n]), the same as from
+    // CBDose::CalcMU. Records are checked first, and nothing is calculated
+    // if one names a missing beam model or an unknown setup type (returns
+    // true if successful).
+    bool Run(const std::vector<MUCheckRecord> &records,
+        std::vector<MUCheckResult> &results);
+    MUCheckStatistics GetStatistics() const { return statistics; }
+  private:
+    std::vector< std::shared_ptr<const CBDose> > models;
+    int num_threads;
+    MUCheckStatistics statistics;
+};
+
+// End header guard
+#endif
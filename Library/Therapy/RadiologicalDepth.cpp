@@ -0,0 +1,183 @@
+/******************************************************************************/
+/*                                                                            */
+/* Copyright 2016-2017 Steven Dolly                                           */
+/*                                                                            */
+/* Licensed under the Apache License, Version 2.0 (the "License");            */
+/* you may not use this file except in compliance with the License.           */
+/* You may obtain a copy of the License at:                                   */
+/*                                                                            */
+/*     http://www.apache.org/licenses/LICENSE-2.0                             */
+/*                                                                            */
+/* Unless required by applicable law or agreed to in writing, software        */
+/* distributed under the License is distributed on an "AS IS" BASIS,          */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   */
+/* See the License for the specific language governing permissions and        */
+/* limitations under the License.                                             */
+/*                                                                            */
+/******************************************************************************/
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// RadiologicalDepth.cpp                                                      //
+// Radiological Depth Ray Tracing Class                                       //
+// Created October 16, 2026                                                   //
+//                                                                            //
+// This file contains a class for the water-equivalent depths of points in a  //
+// linac beam, from ray lines traced once through an x-ray object model.      //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// Class header
+#include "RadiologicalDepth.hpp"
+
+// Standard C++ header files
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// Solutio C++ headers
+#include "Geometry/RayBatch.hpp"
+#include "Utilities/ParallelFor.hpp"
+
+RadiologicalDepth::RadiologicalDepth(){
+  SetBeam(solutio::Vec3<double>(0.0, 0.0, -100.0),
+      solutio::Vec3<double>(0.0, 0.0, 1.0), 100.0);
+  SetRayGrid(0.5, 20.0, 50.0, 150.0, 0.25);
+}
+
+bool RadiologicalDepth::SetBeam(solutio::Vec3<double> source_position,
+    solutio::Vec3<double> axis_direction, float distance){
+  if(!(axis_direction.Magnitude() > 0) || !(distance > 0)){
+    std::cout << "Error: beam axis and SAD must be nonzero!\n";
+    return false;
+  }
+  source = source_position;
+  axis = axis_direction;
+  axis.Normalize();
+  sad = distance;
+  solutio::Vec3<double> reference(1.0, 0.0, 0.0);
+  if(fabs(axis.x) > 0.9) reference.Set(0.0, 1.0, 0.0);
+  across_1 = reference - axis*solutio::Dot(reference, axis);
+  across_1.Normalize();
+  across_2 = solutio::Cross(axis, across_1);
+  profiles.clear();
+  return true;
+}
+
+bool RadiologicalDepth::SetRayGrid(float ray_spacing, float width,
+    float first, float last, float step){
+  if(!(ray_spacing > 0) || !(width > 0) || !(first > 0) || !(last > first) ||
+      !(step > 0)){
+    std::cout << "Error: invalid ray grid!\n";
+    return false;
+  }
+  spacing = ray_spacing;
+  half_width = width;
+  z_first = first;
+  z_last = last;
+  z_step = step;
+  num_lines = std::max(2, int(ceil(2*half_width/spacing - 1.0e-3)) + 1);
+  num_planes = std::max(2, int(ceil((z_last - z_first)/z_step - 1.0e-3)) + 1);
+  profiles.clear();
+  return true;
+}
+
+bool RadiologicalDepth::TraceModel(solutio::ObjectModelXray &model,
+    int threads){
+  std::vector<double> density(model.GetNumMaterials());
+  for(int m = 0; m < density.size(); m++){
+    density[m] = model.GetRelativeElectronDensity(m);
+  }
+  int world = model.GetWorldMaterial();
+  if(world >= 0 && world < density.size()) density[world] = 0.0;
+  int num_rays = num_lines*num_lines;
+  profiles.assign(num_rays*num_planes, 0.0);
+  
+  // Each line is one batch: source to the first plane, then plane to plane
+  int num_threads = solutio::ResolveThreadCount(threads);
+  std::vector<solutio::XrayRayScratch> scratch(num_threads);
+  std::vector<solutio::RayPathCache> caches(num_threads);
+  std::vector<solutio::RayBatch> batches(num_threads,
+      solutio::RayBatch(num_planes));
+  solutio::ParallelFor(num_rays, threads, [&](int ray, int thread_id){
+    float u = (ray / num_lines)*spacing - half_width;
+    float v = (ray % num_lines)*spacing - half_width;
+    solutio::Vec3<double> slope = axis + across_1*double(u/sad) +
+        across_2*double(v/sad);
+    solutio::RayBatch &batch = batches[thread_id];
+    for(int k = 0; k < num_planes; k++){
+      double z_start = (k == 0) ? 0.0 : (z_first + (k - 1)*z_step);
+      double z_end = z_first + k*z_step;
+      solutio::Vec3<double> start = source + slope*z_start;
+      solutio::Vec3<double> direction = slope*(z_end - z_start);
+      batch.origin_x[k] = start.x;
+      batch.origin_y[k] = start.y;
+      batch.origin_z[k] = start.z;
+      batch.direction_x[k] = direction.x;
+      batch.direction_y[k] = direction.y;
+      batch.direction_z[k] = direction.z;
+    }
+    solutio::RayPathCache &cache = caches[thread_id];
+    cache.Clear();
+    model.TraceRays(batch, cache, scratch[thread_id]);
+    float *profile = &profiles[ray*num_planes];
+    double length = 0.0;
+    for(int k = 0; k < num_planes; k++){
+      for(int n = cache.ray_begin[k]; n < cache.ray_begin[(k+1)]; n++){
+        length += cache.lengths[n]*density[(cache.materials[n])];
+      }
+      profile[k] = length;
+    }
+  });
+  return true;
+}
+
+bool RadiologicalDepth::CalcPoints(
+    const std::vector< solutio::Vec3<double> > &points, float ssd,
+    std::vector<float> &depths, std::vector<float> &oads,
+    std::vector<float> &radiological_depths) const {
+  if(profiles.empty()){
+    std::cout << "Error: ray lines have not been traced!\n";
+    return false;
+  }
+  int num_points = points.size();
+  depths.resize(num_points);
+  oads.resize(num_points);
+  radiological_depths.resize(num_points);
+  for(int n = 0; n < num_points; n++){
+    solutio::Vec3<double> w = points[n] - source;
+    double z = solutio::Dot(w, axis);
+    double x = solutio::Dot(w, across_1);
+    double y = solutio::Dot(w, across_2);
+    depths[n] = z - ssd;
+    oads[n] = sqrt(x*x + y*y);
+    if(!(z > 0)){
+      radiological_depths[n] = depths[n];
+      continue;
+    }
+    
+    // Trilinear interpolation between the four nearest lines and the two
+    // nearest planes
+    float f[3];
+    int index[3];
+    float position[3] = {float((x*sad/z + half_width)/spacing),
+        float((y*sad/z + half_width)/spacing), float((z - z_first)/z_step)};
+    int size[3] = {num_lines, num_lines, num_planes};
+    for(int a = 0; a < 3; a++){
+      float p = std::min(std::max(position[a], 0.0f), float(size[a] - 1));
+      index[a] = std::min(int(p), size[a] - 2);
+      f[a] = p - index[a];
+    }
+    float length = 0.0;
+    for(int corner = 0; corner < 4; corner++){
+      int i = index[0] + (corner >> 1), j = index[1] + (corner & 1);
+      const float *profile = &profiles[((i*num_lines + j)*num_planes)];
+      float weight = ((corner >> 1) ? f[0] : (1 - f[0])) *
+          ((corner & 1) ? f[1] : (1 - f[1]));
+      length += weight*((1 - f[2])*profile[index[2]] +
+          f[2]*profile[(index[2]+1)]);
+    }
+    radiological_depths[n] = length*(z/sqrt(w.x*w.x + w.y*w.y + w.z*w.z));
+  }
+  return true;
+}
@@ -0,0 +1,89 @@
+/******************************************************************************/
+/*                                                                            */
+/* Copyright 2016-2017 Steven Dolly                                           */
+/*                                                                            */
+/* Licensed under the Apache License, Version 2.0 (the "License");            */
+/* you may not use this file except in compliance with the License.           */
+/* You may obtain a copy of the License at:                                   */
+/*                                                                            */
+/*     http://www.apache.org/licenses/LICENSE-2.0                             */
+/*                                                                            */
+/* Unless required by applicable law or agreed to in writing, software        */
+/* distributed under the License is distributed on an "AS IS" BASIS,          */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   */
+/* See the License for the specific language governing permissions and        */
+/* limitations under the License.                                             */
+/*                                                                            */
+/******************************************************************************/
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// RadiologicalDepth.hpp                                                      //
+// Radiological Depth Ray Tracing Class Header File                           //
+// Created October 16, 2026                                                   //
+//                                                                            //
+// This header file contains a class for the water-equivalent (radiological)  //
+// depths of points in a linac beam, for heterogeneity-corrected CBDose       //
+// calculations. Ray lines from the source are traced once through an x-ray   //
+// object model, and the equivalent path length of any point in the beam is   //
+// interpolated from the nearest lines.                                       //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// Header guard
+#ifndef RADIOLOGICALDEPTH_HPP
+#define RADIOLOGICALDEPTH_HPP
+
+// Standard C++ header files
+#include <vector>
+
+// Solutio C++ headers
+#include "Geometry/Vec3.hpp"
+#include "Imaging/ObjectModelXray.hpp"
+
+// The ray lines pass through a square grid of points on the isocenter plane.
+// Each line is traced once, as consecutive segments between planes spaced
+// along the central axis, and the water-equivalent length from the source
+// (path lengths scaled by relative electron density) is kept at each plane.
+class RadiologicalDepth {
+  public:
+    RadiologicalDepth();
+    // Source position and central axis direction (toward the isocenter), in
+    // the model coordinates (cm), and the source-to-isocenter distance
+    bool SetBeam(solutio::Vec3<double> source, solutio::Vec3<double> axis,
+        float sad);
+    // Ray lines spaced by ray_spacing on the isocenter plane, out to
+    // half_width from the central axis, sampled every z_step between the
+    // planes at z_first and z_last from the source (along the central axis)
+    bool SetRayGrid(float ray_spacing, float half_width, float z_first,
+        float z_last, float z_step);
+    // Trace all ray lines through the model, in parallel (0 threads = all
+    // hardware threads). Voxel and analytic models both count path lengths
+    // along each segment only. The model's world material (outside all
+    // objects, or a voxel model's background) is not counted, so the air
+    // between the source and the surface adds no depth.
+    bool TraceModel(solutio::ObjectModelXray &model, int threads = 0);
+    bool IsTraced() const { return !profiles.empty(); }
+    int GetNumRays() const { return (num_lines*num_lines); }
+    // Depth below a flat surface at ssd and off-axis distance (both as for
+    // CalcPoint, along and from the central axis), and the radiological
+    // depth of points. The radiological depth is the equivalent path length
+    // from the source projected on the central axis, so it equals the depth
+    // in water. Points beyond the ray grid get the values at its edge.
+    bool CalcPoints(const std::vector< solutio::Vec3<double> > &points,
+        float ssd, std::vector<float> &depths, std::vector<float> &oads,
+        std::vector<float> &radiological_depths) const;
+  private:
+    // Beam, with two unit vectors across the central axis
+    solutio::Vec3<double> source, axis, across_1, across_2;
+    float sad;
+    // Ray grid
+    float spacing, half_width, z_first, z_last, z_step;
+    int num_lines; // Lines along each side of the grid
+    int num_planes;
+    // Equivalent path length of each line at each plane (line by line)
+    std::vector<float> profiles;
+};
+
+// End header guard
+#endif
@@ -32,6 +32,7 @@
 #define DATAINTERPOLATION_HPP
 
 // Standard C++ header files
+#include <algorithm>
 #include <vector>
 #include <utility>
 
@@ -129,9 +130,9 @@ namespace solutio
     int index = ceil((x_value-x_data[0])/delta_x);
     if(index <= 0) index = 1;
     if(index >= x_data.size()) index = x_data.size()-1;
-    float y_1 = LinearInterpolationQuick(y_data, table[(index-1)],
+    float y_1 = LinearInterpolationFast(y_data, table[(index-1)],
         y_value, delta_y);
-    float y_2 = LinearInterpolationQuick(y_data, table[index],
+    float y_2 = LinearInterpolationFast(y_data, table[index],
         y_value, delta_y);
     T f = (x_value - x_data[(index-1)]) / (x_data[index] - x_data[(index-1)]);
     T t_value = f*y_2 + (1-f)*y_1;
@@ -162,6 +163,187 @@ namespace solutio
     T value_y = (pow(y_data[index], f) * pow(y_data[(index-1)],(1-f)));
     return value_y;
   }
+
+  //////////////////////////////////////////////////////////////////////////////
+  //                                                                          //
+  // Searched interpolation on data views: unspecified sample size            //
+  //                                                                          //
+  // Interpolation for irregularly-spaced samples stored in contiguous        //
+  // memory, passed through a DataView so the tables are never copied. The    //
+  // row index is found by binary search, or by walking from a remembered     //
+  // "hint" index for monotone streams of queries. The x data must be in      //
+  // ascending order; repeated x values (e.g. absorption edges) are allowed.  //
+  // Results are identical to the normal interpolation functions above.       //
+  //                                                                          //
+  //////////////////////////////////////////////////////////////////////////////
+
+  // Read-only view of contiguous data (e.g. a std::vector or a mapped file)
+  template <class T>
+  struct DataView
+  {
+    DataView() : data(0), size(0) {}
+    DataView(const T *d, int n) : data(d), size(n) {}
+    DataView(const std::vector<T> &v) : data(v.empty() ? 0 : &v[0]),
+        size(v.size()) {}
+    const T &operator[](int n) const { return data[n]; }
+    const T *data;
+    int size;
+  };
+
+  template <class T>
+  DataView<T> MakeDataView(const std::vector<T> &v){ return DataView<T>(v); }
+
+  // Precompute the log10 of every sample, for use with LogInterpolation*
+  template <class T>
+  std::vector<T> Log10Table(DataView<T> data)
+  {
+    std::vector<T> log_data(data.size);
+    for(int n = 0; n < data.size; n++) log_data[n] = log10(data[n]);
+    return log_data;
+  }
+
+  // Upper index of the interpolation interval, found by binary search. This
+  // is the same index the linear search above ends on: the first sample
+  // greater than x_value, limited to the range [1, size-1].
+  template <class T>
+  int BracketIndex(DataView<T> x_data, T x_value)
+  {
+    int index = std::upper_bound(x_data.data, x_data.data + x_data.size,
+        x_value) - x_data.data;
+    if(index <= 0) index = 1;
+    if(index >= x_data.size) index = x_data.size-1;
+    return index;
+  }
+
+  // Upper index of the interpolation interval, found by walking from the
+  // index of the previous query. The hint is updated for the next query and
+  // may start at any value (e.g. 0).
+  template <class T>
+  int BracketIndex(DataView<T> x_data, T x_value, int &hint)
+  {
+    int index = hint;
+    if(index < 0) index = 0;
+    if(index > x_data.size) index = x_data.size;
+    while((index < x_data.size) && (x_value >= x_data[index])) index++;
+    while((index > 0) && (x_value < x_data[(index-1)])) index--;
+    hint = index;
+    if(index <= 0) index = 1;
+    if(index >= x_data.size) index = x_data.size-1;
+    return index;
+  }
+
+  // Linear interpolation between samples (index-1) and index
+  template <class T>
+  T LinearInterpolationAt(DataView<T> x_data, DataView<T> y_data, T x_value,
+      int index)
+  {
+    T f = (x_value - x_data[(index-1)]) / (x_data[index] - x_data[(index-1)]);
+    T y_value = f*y_data[index] + (1-f)*y_data[(index-1)];
+    return y_value;
+  }
+
+  // Logarithmic interpolation between samples (index-1) and index, using the
+  // precomputed log10 of the x data
+  template <class T>
+  T LogInterpolationAt(DataView<T> log_x_data, DataView<T> y_data, T x_value,
+      int index)
+  {
+    T f = (log10(x_value) - log_x_data[(index-1)]) /
+        (log_x_data[index] - log_x_data[(index-1)]);
+    T value_y = (pow(y_data[index], f) * pow(y_data[(index-1)],(1-f)));
+    return value_y;
+  }
+
+  // Binary search linear interpolation for 1D data
+  template <class T>
+  T LinearInterpolationSearch(DataView<T> x_data, DataView<T> y_data,
+      T x_value)
+  {
+    return LinearInterpolationAt(x_data, y_data, x_value,
+        BracketIndex(x_data, x_value));
+  }
+
+  template <class T>
+  T LinearInterpolationSearch(const std::vector<T> &x_data,
+      const std::vector<T> &y_data, T x_value)
+  {
+    return LinearInterpolationSearch(MakeDataView(x_data),
+        MakeDataView(y_data), x_value);
+  }
+
+  // Hinted linear interpolation for 1D data
+  template <class T>
+  T LinearInterpolationHint(DataView<T> x_data, DataView<T> y_data,
+      T x_value, int &hint)
+  {
+    return LinearInterpolationAt(x_data, y_data, x_value,
+        BracketIndex(x_data, x_value, hint));
+  }
+
+  // Binary search linear interpolation for 2D data; table rows correspond to
+  // x samples and columns to y samples
+  template <class T>
+  T LinearInterpolationSearch(DataView<T> x_data, DataView<T> y_data,
+      const std::vector< std::vector<T> > &table, T x_value, T y_value)
+  {
+    int index = BracketIndex(x_data, x_value);
+    int y_index = BracketIndex(y_data, y_value);
+    T y_1 = LinearInterpolationAt(y_data, MakeDataView(table[(index-1)]),
+        y_value, y_index);
+    T y_2 = LinearInterpolationAt(y_data, MakeDataView(table[index]),
+        y_value, y_index);
+    T f = (x_value - x_data[(index-1)]) / (x_data[index] - x_data[(index-1)]);
+    T t_value = f*y_2 + (1-f)*y_1;
+    return t_value;
+  }
+
+  template <class T>
+  T LinearInterpolationSearch(const std::vector<T> &x_data,
+      const std::vector<T> &y_data, const std::vector< std::vector<T> > &table,
+      T x_value, T y_value)
+  {
+    return LinearInterpolationSearch(MakeDataView(x_data),
+        MakeDataView(y_data), table, x_value, y_value);
+  }
+
+  // Binary search linear interpolation for 2D data in a contiguous row-major
+  // table of (x_data.size x y_data.size) samples
+  template <class T>
+  T LinearInterpolationSearch(DataView<T> x_data, DataView<T> y_data,
+      DataView<T> table, T x_value, T y_value)
+  {
+    int index = BracketIndex(x_data, x_value);
+    int y_index = BracketIndex(y_data, y_value);
+    T y_1 = LinearInterpolationAt(y_data,
+        DataView<T>(table.data + (index-1)*y_data.size, y_data.size),
+        y_value, y_index);
+    T y_2 = LinearInterpolationAt(y_data,
+        DataView<T>(table.data + index*y_data.size, y_data.size),
+        y_value, y_index);
+    T f = (x_value - x_data[(index-1)]) / (x_data[index] - x_data[(index-1)]);
+    T t_value = f*y_2 + (1-f)*y_1;
+    return t_value;
+  }
+
+  // Binary search logarithmic interpolation for 1D data, given the
+  // precomputed log10 of the x data (see Log10Table)
+  template <class T>
+  T LogInterpolationSearch(DataView<T> x_data, DataView<T> log_x_data,
+      DataView<T> y_data, T x_value)
+  {
+    return LogInterpolationAt(log_x_data, y_data, x_value,
+        BracketIndex(x_data, x_value));
+  }
+
+  // Hinted logarithmic interpolation for 1D data, given the precomputed
+  // log10 of the x data (see Log10Table)
+  template <class T>
+  T LogInterpolationHint(DataView<T> x_data, DataView<T> log_x_data,
+      DataView<T> y_data, T x_value, int &hint)
+  {
+    return LogInterpolationAt(log_x_data, y_data, x_value,
+        BracketIndex(x_data, x_value, hint));
+  }
   
 };
   
@@ -0,0 +1,92 @@
+/******************************************************************************/
+/*                                                                            */
+/* Copyright 2016-2017 Steven Dolly                                           */
+/*                                                                            */
+/* Licensed under the Apache License, Version 2.0 (the "License");            */
+/* you may not use this file except in compliance with the License.           */
+/* You may obtain a copy of the License at:                                   */
+/*                                                                            */
+/*     http://www.apache.org/licenses/LICENSE-2.0                             */
+/*                                                                            */
+/* Unless required by applicable law or agreed to in writing, software        */
+/* distributed under the License is distributed on an "AS IS" BASIS,          */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   */
+/* See the License for the specific language governing permissions and        */
+/* limitations under the License.                                             */
+/*                                                                            */
+/******************************************************************************/
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// FastFourierTransform.hpp                                                   //
+// Fast Fourier Transform Functions                                           //
+// Created October 15, 2026                                                   //
+//                                                                            //
+// This header file contains an in-place radix-2 complex fast Fourier         //
+// transform, used for convolution filtering of projection data.              //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// Header guard
+#ifndef FASTFOURIERTRANSFORM_HPP
+#define FASTFOURIERTRANSFORM_HPP
+
+// Standard C++ header files
+#include <complex>
+#include <vector>
+
+// Standard C header files
+#include <cmath>
+
+namespace solutio
+{
+  // Smallest power of two that is not less than n
+  inline int PowerOfTwoSize(int n)
+  {
+    int size = 1;
+    while(size < n) size *= 2;
+    return size;
+  }
+
+  // In-place transform of data (size must be a power of two); the inverse
+  // transform includes the 1/N scaling
+  template <class T>
+  void FastFourierTransform(std::vector< std::complex<T> > &data,
+      bool inverse = false)
+  {
+    int n = data.size();
+    // Bit-reversal permutation
+    for(int i = 1, j = 0; i < n; i++)
+    {
+      int bit = n >> 1;
+      for(; j & bit; bit >>= 1) j ^= bit;
+      j ^= bit;
+      if(i < j) std::swap(data[i], data[j]);
+    }
+    // Butterflies
+    for(int length = 2; length <= n; length <<= 1)
+    {
+      T angle = 2.0*M_PI/length*(inverse ? 1.0 : -1.0);
+      std::complex<T> w_length(cos(angle), sin(angle));
+      for(int i = 0; i < n; i += length)
+      {
+        std::complex<T> w(1.0, 0.0);
+        for(int k = 0; k < length/2; k++)
+        {
+          std::complex<T> u = data[(i + k)];
+          std::complex<T> v = data[(i + k + length/2)]*w;
+          data[(i + k)] = u + v;
+          data[(i + k + length/2)] = u - v;
+          w *= w_length;
+        }
+      }
+    }
+    if(inverse)
+    {
+      for(int i = 0; i < n; i++) data[i] /= T(n);
+    }
+  }
+}
+
+// End header guard
+#endif
@@ -0,0 +1,81 @@
+/******************************************************************************/
+/*                                                                            */
+/* Copyright 2016-2017 Steven Dolly                                           */
+/*                                                                            */
+/* Licensed under the Apache License, Version 2.0 (the "License");            */
+/* you may not use this file except in compliance with the License.           */
+/* You may obtain a copy of the License at:                                   */
+/*                                                                            */
+/*     http://www.apache.org/licenses/LICENSE-2.0                             */
+/*                                                                            */
+/* Unless required by applicable law or agreed to in writing, software        */
+/* distributed under the License is distributed on an "AS IS" BASIS,          */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   */
+/* See the License for the specific language governing permissions and        */
+/* limitations under the License.                                             */
+/*                                                                            */
+/******************************************************************************/
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// ParallelFor.hpp                                                            //
+// Parallel Task Loop Functions                                               //
+// Created October 15, 2026                                                   //
+//                                                                            //
+// This header file contains template functions to run a set of independent  //
+// tasks on a pool of worker threads. Tasks are handed out dynamically from   //
+// a shared counter, so each task must write only to its own output.         //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// Header guard
+#ifndef PARALLELFOR_HPP
+#define PARALLELFOR_HPP
+
+// Standard C++ header files
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace solutio
+{
+  // Number of worker threads to use for a requested thread count (0 = all
+  // available hardware threads)
+  inline int ResolveThreadCount(int num_threads)
+  {
+    if(num_threads > 0) return num_threads;
+    int hardware_threads = std::thread::hardware_concurrency();
+    if(hardware_threads < 1) hardware_threads = 1;
+    return hardware_threads;
+  }
+
+  // Run task(n) for n = 0 ... num_tasks-1 across num_threads threads. The
+  // second argument given to the task is the id of the worker thread running
+  // it (0 ... num_threads-1), for use with per-thread scratch data.
+  template <class F>
+  void ParallelFor(int num_tasks, int num_threads, F task)
+  {
+    num_threads = ResolveThreadCount(num_threads);
+    if(num_threads > num_tasks) num_threads = num_tasks;
+    if(num_threads <= 1)
+    {
+      for(int n = 0; n < num_tasks; n++) task(n, 0);
+      return;
+    }
+
+    std::atomic<int> next_task(0);
+    std::vector<std::thread> workers;
+    for(int t = 0; t < num_threads; t++)
+    {
+      workers.push_back(std::thread([&next_task, &task, num_tasks, t]()
+      {
+        int n;
+        while((n = next_task.fetch_add(1)) < num_tasks) task(n, t);
+      }));
+    }
+    for(int t = 0; t < num_threads; t++) workers[t].join();
+  }
+}
+
+// End header guard
+#endif
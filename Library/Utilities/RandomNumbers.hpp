@@ -0,0 +1,180 @@
+/******************************************************************************/
+/*                                                                            */
+/* Copyright 2016-2017 Steven Dolly                                           */
+/*                                                                            */
+/* Licensed under the Apache License, Version 2.0 (the "License");            */
+/* you may not use this file except in compliance with the License.           */
+/* You may obtain a copy of the License at:                                   */
+/*                                                                            */
+/*     http://www.apache.org/licenses/LICENSE-2.0                             */
+/*                                                                            */
+/* Unless required by applicable law or agreed to in writing, software        */
+/* distributed under the License is distributed on an "AS IS" BASIS,          */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   */
+/* See the License for the specific language governing permissions and        */
+/* limitations under the License.                                             */
+/*                                                                            */
+/******************************************************************************/
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// RandomNumbers.hpp                                                          //
+// Counter-Based Random Number Functions                                      //
+// Created October 15, 2026                                                   //
+//                                                                            //
+// This header file contains the Philox4x32-10 counter-based generator        //
+// (Salmon et al., SC11) and samplers built on it. Every random number is a   //
+// pure function of a key and a counter, so independent streams (e.g. one per //
+// detector element) can be drawn in any order, on any thread, and give the   //
+// same values.                                                               //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// Header guard
+#ifndef RANDOMNUMBERS_HPP
+#define RANDOMNUMBERS_HPP
+
+// Standard C++ header files
+#include <cstdint>
+
+// Standard C header files
+#include <cmath>
+
+namespace solutio
+{
+  // Philox4x32-10 block function: four random 32-bit words from a 128-bit
+  // counter and a 64-bit key
+  inline void Philox4x32(const uint32_t counter[4], const uint32_t key[2],
+      uint32_t output[4])
+  {
+    uint32_t x0 = counter[0], x1 = counter[1], x2 = counter[2],
+        x3 = counter[3];
+    uint32_t k0 = key[0], k1 = key[1];
+    for(int round = 0; round < 10; round++)
+    {
+      uint64_t p0 = uint64_t(0xD2511F53u)*x0;
+      uint64_t p1 = uint64_t(0xCD9E8D57u)*x2;
+      uint32_t y0 = uint32_t(p1 >> 32) ^ x1 ^ k0;
+      uint32_t y1 = uint32_t(p1);
+      uint32_t y2 = uint32_t(p0 >> 32) ^ x3 ^ k1;
+      uint32_t y3 = uint32_t(p0);
+      x0 = y0; x1 = y1; x2 = y2; x3 = y3;
+      k0 += 0x9E3779B9u;
+      k1 += 0xBB67AE85u;
+    }
+    output[0] = x0; output[1] = x1; output[2] = x2; output[3] = x3;
+  }
+
+  // Uniform double in (0, 1) from 64 random bits (53 bits used)
+  inline double UniformFromBits(uint32_t high, uint32_t low)
+  {
+    uint64_t bits = ((uint64_t(high) << 32) | low) >> 11;
+    return (double(bits) + 0.5)*(1.0/9007199254740992.0);
+  }
+
+  // Natural log of k!, exact sums below 16 and Stirling's series above
+  inline double LogFactorial(double k)
+  {
+    if(k < 16.0)
+    {
+      double sum = 0.0;
+      for(int i = 2; i <= int(k); i++) sum += log(double(i));
+      return sum;
+    }
+    double k_inv = 1.0/k, k_inv2 = k_inv*k_inv;
+    return (k + 0.5)*log(k) - k + 0.91893853320467274 +
+        k_inv*(1.0/12.0 - k_inv2*(1.0/360.0 - k_inv2/1260.0));
+  }
+
+  // SplitMix64 finalizer, spreads the seed bits over the whole key
+  inline uint64_t MixSeed(uint64_t seed)
+  {
+    seed += 0x9E3779B97F4A7C15ull;
+    seed = (seed ^ (seed >> 30))*0xBF58476D1CE4E5B9ull;
+    seed = (seed ^ (seed >> 27))*0x94D049BB133111EBull;
+    return seed ^ (seed >> 31);
+  }
+
+  // A stream of random numbers identified by a 64-bit seed, a stream index
+  // and three 32-bit indices; the hashed seed and the stream index form the
+  // key, the indices the first three counter words, and the fourth counter
+  // word counts the blocks drawn
+  class PhiloxStream
+  {
+    public:
+      PhiloxStream(uint64_t seed, uint32_t i, uint32_t j, uint32_t k,
+          uint32_t stream = 0)
+      {
+        uint64_t mixed = MixSeed(seed);
+        key[0] = uint32_t(mixed);
+        key[1] = uint32_t(mixed >> 32) ^ stream;
+        counter[0] = i;
+        counter[1] = j;
+        counter[2] = k;
+        counter[3] = 0;
+        cached = 0;
+      }
+      // Uniform random number in (0, 1)
+      double Uniform()
+      {
+        if(cached == 0)
+        {
+          Philox4x32(counter, key, block);
+          counter[3]++;
+          cached = 2;
+          return UniformFromBits(block[0], block[1]);
+        }
+        cached = 0;
+        return UniformFromBits(block[2], block[3]);
+      }
+      // Normally distributed random number (Box-Muller transform)
+      double Normal(double mean, double stddev)
+      {
+        double r = sqrt(-2.0*log(Uniform()));
+        return mean + stddev*r*cos(2.0*M_PI*Uniform());
+      }
+      // Poisson distributed random number; multiplication of uniforms for
+      // small means and transformed rejection with squeeze (PTRS, Hormann
+      // 1993) above 10, which needs about 1.1 uniform pairs per sample for
+      // any mean
+      double Poisson(double mean)
+      {
+        if(mean <= 0.0) return 0.0;
+        if(mean < 10.0)
+        {
+          double limit = exp(-mean), product = Uniform();
+          double k = 0.0;
+          while(product > limit)
+          {
+            product *= Uniform();
+            k += 1.0;
+          }
+          return k;
+        }
+        double sqrt_mean = sqrt(mean), log_mean = log(mean);
+        double b = 0.931 + 2.53*sqrt_mean;
+        double a = -0.059 + 0.02483*b;
+        double inv_alpha = 1.1239 + 1.1328/(b - 3.4);
+        double v_r = 0.9277 - 3.6224/(b - 2.0);
+        while(true)
+        {
+          double u = Uniform() - 0.5;
+          double v = Uniform();
+          double u_s = 0.5 - fabs(u);
+          double k = floor((2.0*a/u_s + b)*u + mean + 0.43);
+          if(u_s >= 0.07 && v <= v_r) return k;
+          if(k < 0.0 || (u_s < 0.013 && v > u_s)) continue;
+          if(log(v*inv_alpha/(a/(u_s*u_s) + b)) <=
+              -mean + k*log_mean - LogFactorial(k)) return k;
+        }
+      }
+    private:
+      uint32_t key[2];
+      uint32_t counter[4];
+      uint32_t block[4];
+      int cached;
+  };
+}
+
+// End header guard
+#endif